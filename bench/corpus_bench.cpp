@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/InitLLVM.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "binary_writer.h"
+#include "corpus.h"
+#include "driver.h"
+#include "dump_ast.h"
+#include "json_writer.h"
+#include "null_writer.h"
+#include "options.h"
+
+// === dump-ast-bench ===
+//
+// Times the phases of the dump for each file of a corpus:
+//   parse      everything up to the parse tree: reading, prescanning and
+//              parsing the file
+//   walk       visiting the parse tree with a writer that discards the dump
+//   dump       visiting the parse tree and serializing it
+// and reports one JSON record per line, followed by a summary record. The
+// serialization cost is dump - walk. Output is counted, not stored.
+
+namespace cl = llvm::cl;
+
+static cl::OptionCategory benchCategory("dump-ast-bench options");
+
+static cl::list<std::string> inputs(cl::Positional,
+                                    cl::desc("<file or directory>..."),
+                                    cl::cat(benchCategory));
+
+static cl::opt<std::string>
+    filesFrom("files-from", cl::desc("Read the input paths from a file"),
+              cl::value_desc("path"), cl::cat(benchCategory));
+
+static cl::opt<std::string>
+    extension("ext", cl::desc("Extension of the files searched in directories"),
+              cl::init("f90"), cl::cat(benchCategory));
+
+static cl::opt<std::string>
+    outputPath("o", cl::desc("Where to write the report"),
+               cl::value_desc("path"), cl::init("-"), cl::cat(benchCategory));
+
+static cl::opt<unsigned>
+    repeat("repeat",
+           cl::desc("Runs per file, the fastest time of each phase is kept"),
+           cl::init(1), cl::cat(benchCategory));
+
+enum class OutputFormat { Json, Binary };
+
+static cl::opt<OutputFormat> outputFormat(
+    "output-format", cl::desc("Format whose serialization is measured"),
+    cl::values(clEnumValN(OutputFormat::Json, "json", "JSON (default)"),
+               clEnumValN(OutputFormat::Binary, "binary",
+                          "Binary AST format")),
+    cl::init(OutputFormat::Json), cl::cat(benchCategory));
+
+static cl::list<std::string>
+    flangArguments("Xflang", cl::desc("Pass an argument to flang -fc1"),
+                   cl::value_desc("arg"), cl::cat(benchCategory));
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double seconds(Clock::duration d) {
+  return std::chrono::duration<double>(d).count();
+}
+
+// Stream that only counts what is written to it
+class CountingStream : public llvm::raw_ostream {
+public:
+  CountingStream() { SetUnbuffered(); }
+
+private:
+  void write_impl(const char *, size_t size) override { count += size; }
+  uint64_t current_pos() const override { return count; }
+
+  uint64_t count = 0;
+};
+
+struct Measure {
+  double parse = std::numeric_limits<double>::infinity();
+  double walk = std::numeric_limits<double>::infinity();
+  double dump = std::numeric_limits<double>::infinity();
+  std::uint64_t sourceBytes = 0;
+  std::uint64_t nodes = 0;
+  std::uint64_t outputBytes = 0;
+};
+
+// Dump action that records the time of each phase into a Measure
+class BenchAction : public DumpAST {
+public:
+  BenchAction(const DumpOptions &options, Measure &measure)
+      : DumpAST(stream, options), measure(measure) {}
+
+  // Time spent in executeAction, the rest of the run is parsing
+  double executeTime = 0;
+
+protected:
+  void executeAction() override {
+    auto executeStart = Clock::now();
+    measure.sourceBytes = getParsing().cooked().AsCharBlock().size();
+
+    NullWriter null;
+    auto start = Clock::now();
+    dumpParseTree(null);
+    measure.walk = std::min(measure.walk, seconds(Clock::now() - start));
+    measure.nodes = null.nodes();
+
+    start = Clock::now();
+    if (outputFormat == OutputFormat::Binary) {
+      BinaryWriter out(stream, options);
+      dumpParseTree(out);
+    } else {
+      JsonWriter out(stream, options);
+      dumpParseTree(out);
+    }
+    measure.dump = std::min(measure.dump, seconds(Clock::now() - start));
+    measure.outputBytes = stream.tell();
+    executeTime = seconds(Clock::now() - executeStart);
+  }
+
+private:
+  CountingStream stream;
+  Measure &measure;
+};
+
+// High-water mark of the resident set of the process, in KiB
+long peakRss() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  llvm::InitLLVM init(argc, argv);
+  cl::ParseCommandLineOptions(
+      argc, argv, "Measures the dump of a corpus of Fortran files\n");
+
+  std::vector<std::string> paths(inputs.begin(), inputs.end());
+  if (!filesFrom.empty() && !readPathList(filesFrom, paths))
+    return 1;
+  std::vector<std::string> files;
+  for (const auto &path : paths)
+    collectSources(path, extension, files);
+
+  std::error_code ec;
+  llvm::raw_fd_ostream os(outputPath, ec, llvm::sys::fs::OF_Text);
+  if (ec) {
+    llvm::errs() << outputPath << ": " << ec.message() << "\n";
+    return 1;
+  }
+
+  initializeFrontend();
+  DumpOptions options = DumpOptions::fromCommandLine();
+  // The dumps are only counted
+  options.output.clear();
+  std::vector<std::string> arguments(flangArguments.begin(),
+                                     flangArguments.end());
+
+  Measure total{0, 0, 0};
+  std::size_t failures = 0;
+  for (const auto &file : files) {
+    Measure measure;
+    bool success = true;
+    for (unsigned i = 0; i < std::max(1u, unsigned(repeat)) && success; ++i) {
+      BenchAction action(options, measure);
+      auto start = Clock::now();
+      success = runFrontendAction(action, file, arguments);
+      double parse = seconds(Clock::now() - start) - action.executeTime;
+      measure.parse = std::min(measure.parse, parse);
+    }
+
+    llvm::json::OStream record(os);
+    record.object([&] {
+      record.attribute("file", file);
+      record.attribute("status", success ? "ok" : "error");
+      if (success) {
+        record.attribute("source_bytes", measure.sourceBytes);
+        record.attribute("nodes", measure.nodes);
+        record.attribute("output_bytes", measure.outputBytes);
+        record.attribute("parse_s", measure.parse);
+        record.attribute("walk_s", measure.walk);
+        record.attribute("dump_s", measure.dump);
+        record.attribute("serialize_s",
+                         std::max(0.0, measure.dump - measure.walk));
+        // Below the clock resolution for tiny files
+        if (measure.dump > 0) {
+          record.attribute("nodes_per_s", measure.nodes / measure.dump);
+          record.attribute("bytes_per_s",
+                           measure.outputBytes / measure.dump);
+        }
+      }
+    });
+    os << "\n";
+
+    if (!success) {
+      ++failures;
+      continue;
+    }
+    total.parse += measure.parse;
+    total.walk += measure.walk;
+    total.dump += measure.dump;
+    total.sourceBytes += measure.sourceBytes;
+    total.nodes += measure.nodes;
+    total.outputBytes += measure.outputBytes;
+  }
+
+  llvm::json::OStream summary(os);
+  summary.object([&] {
+    summary.attributeObject("summary", [&] {
+      summary.attribute("files", int64_t(files.size()));
+      summary.attribute("failures", int64_t(failures));
+      summary.attribute("source_bytes", total.sourceBytes);
+      summary.attribute("nodes", total.nodes);
+      summary.attribute("output_bytes", total.outputBytes);
+      summary.attribute("parse_s", total.parse);
+      summary.attribute("walk_s", total.walk);
+      summary.attribute("dump_s", total.dump);
+      summary.attribute("serialize_s", std::max(0.0, total.dump - total.walk));
+      if (total.dump > 0) {
+        summary.attribute("nodes_per_s", total.nodes / total.dump);
+        summary.attribute("bytes_per_s", total.outputBytes / total.dump);
+      }
+      // Of the whole run: the process never gives the high-water mark back,
+      // so it is not measured per file
+      summary.attribute("peak_rss_kib", int64_t(peakRss()));
+    });
+  });
+  os << "\n";
+
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,188 @@
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/Format.h>
+#include <llvm/Support/InitLLVM.h>
+#include <llvm/Support/WithColor.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "json_escape.h"
+#include "json_writer.h"
+
+// Checks the JSON escaper against a straightforward reference on random
+// inputs, then measures its throughput on text shaped like Fortran source.
+// Exits with a non-zero status if any input is escaped differently.
+
+static llvm::cl::opt<unsigned> fuzzIterations(
+    "fuzz-iterations", llvm::cl::desc("Number of random inputs to check"),
+    llvm::cl::init(100000));
+
+static llvm::cl::opt<unsigned>
+    seed("seed", llvm::cl::desc("Seed of the random inputs"), llvm::cl::init(1));
+
+static llvm::cl::opt<unsigned> benchSize(
+    "bench-size", llvm::cl::desc("Size in MiB of the benchmark input"),
+    llvm::cl::init(64));
+
+namespace {
+
+std::string referenceEscape(std::string_view s) {
+  std::string result;
+  for (char c : s) {
+    switch (c) {
+    case '"':
+      result += "\\\"";
+      break;
+    case '\\':
+      result += "\\\\";
+      break;
+    case '\b':
+      result += "\\b";
+      break;
+    case '\f':
+      result += "\\f";
+      break;
+    case '\n':
+      result += "\\n";
+      break;
+    case '\r':
+      result += "\\r";
+      break;
+    case '\t':
+      result += "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        static constexpr char hexDigits[] = "0123456789abcdef";
+        result += "\\u00";
+        result += hexDigits[static_cast<unsigned char>(c) >> 4];
+        result += hexDigits[c & 0xf];
+      } else {
+        result += c;
+      }
+    }
+  }
+  return result;
+}
+
+std::string escape(std::string_view s) {
+  std::string result;
+  {
+    llvm::raw_string_ostream os(result);
+    JsonWriter out(os, {}, 64);
+    out.writeEscaped(s);
+  }
+  return result;
+}
+
+// Random input, mostly plain characters with the occasional one to escape,
+// and every byte value possible
+std::string randomInput(std::mt19937 &random) {
+  static constexpr char special[] = {'"', '\\', '\n', '\r', '\t', '\0', 0x1f,
+                                     0x20, 0x7f, char(0x80), char(0xff)};
+  std::uniform_int_distribution<int> size(0, 200);
+  std::uniform_int_distribution<int> kind(0, 15);
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::uniform_int_distribution<int> letter('a', 'z');
+  std::uniform_int_distribution<std::size_t> pick(0, sizeof(special) - 1);
+
+  std::string input(size(random), ' ');
+  for (auto &c : input) {
+    int k = kind(random);
+    c = k == 0 ? char(byte(random))
+        : k == 1 ? special[pick(random)]
+                 : char(letter(random));
+  }
+  return input;
+}
+
+bool fuzz() {
+  std::mt19937 random(seed);
+  for (unsigned i = 0; i < fuzzIterations; ++i) {
+    std::string input = randomInput(random);
+
+    // Check find from every offset, to cover every alignment and tail size
+    const char *end = input.data() + input.size();
+    for (const char *p = input.data(); p <= end; ++p) {
+      if (json_escape::find(p, end) != json_escape::findScalar(p, end)) {
+        llvm::WithColor::error() << "find differs at input " << i
+                                 << ", offset " << (p - input.data()) << "\n";
+        return false;
+      }
+    }
+
+    if (escape(input) != referenceEscape(input)) {
+      llvm::WithColor::error() << "escaping differs at input " << i << "\n";
+      return false;
+    }
+  }
+  return true;
+}
+
+// Source-like text: lines of code with a few quoted literals
+std::string benchInput() {
+  std::string line = "      x(i) = y(i) * 2.0 + 'it''s' // \"quoted\"\n";
+  std::string input;
+  input.reserve(std::size_t(benchSize) << 20);
+  while (input.size() + line.size() <= (std::size_t(benchSize) << 20))
+    input += line;
+  return input;
+}
+
+template <typename F> double measure(F &&f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+void bench() {
+  std::string input = benchInput();
+  double megabytes = input.size() / double(1 << 20);
+  std::size_t size = 0;
+
+  double escaper = measure([&] {
+    llvm::raw_null_ostream os;
+    JsonWriter out(os);
+    out.writeEscaped(input);
+  });
+  double scalar = measure([&] {
+    const char *p = input.data();
+    const char *end = p + input.size();
+    while ((p = json_escape::findScalar(p, end)) != end) {
+      ++size;
+      ++p;
+    }
+  });
+  double reference = measure([&] { size += referenceEscape(input).size(); });
+
+  llvm::outs() << "input: " << llvm::format("%.0f", megabytes) << " MiB\n";
+  llvm::outs() << llvm::format("writeEscaped:    %8.1f MiB/s\n",
+                               megabytes / escaper);
+  llvm::outs() << llvm::format("findScalar scan: %8.1f MiB/s\n",
+                               megabytes / scalar);
+  llvm::outs() << llvm::format("reference:       %8.1f MiB/s\n",
+                               megabytes / reference);
+  // Keeps the scans from being optimized out
+  if (size == 0)
+    llvm::outs() << "\n";
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  llvm::InitLLVM init(argc, argv);
+  llvm::cl::ParseCommandLineOptions(argc, argv,
+                                    "JSON escaper fuzzer and benchmark\n");
+
+  if (!fuzz())
+    return 1;
+  llvm::outs() << "fuzz: " << fuzzIterations << " inputs OK\n";
+
+  bench();
+  return 0;
+}
@@ -25,21 +25,26 @@ success = 0
 for f90_file in f90_files:
     relative_path = f90_file.relative_to(input_folder).with_suffix(".json")
     out = output_folder / relative_path
-    cmd = ["flang-20", "-fc1", "-load", "./build/DumpASTPlugin.so", "-plugin", "dump-ast", str(f90_file)]
+    out.parent.mkdir(parents=True, exist_ok=True)
+    # The plugin writes the dump straight to the output file
+    cmd = ["flang-20", "-fc1", "-load", "./build/DumpASTPlugin.so", "-plugin", "dump-ast",
+           "-mllvm", "-dump-ast-output=" + str(out), str(f90_file)]
     print("(" + str(counter) + "/" + str(total_files) + ") " + " ".join(cmd))
     try:
         result = subprocess.run(cmd, timeout=5, capture_output=True, text=True)
     except subprocess.TimeoutExpired as e:
         timeouts.append(f90_file)
+        # The killed plugin may have written part of the dump
+        out.unlink(missing_ok=True)
+        counter += 1
+        continue
 
     if result.returncode == 0:
       success += 1
-      out.parent.mkdir(parents=True, exist_ok=True)
-      with open(out, "w") as f:
-        f.write(result.stdout);
     else:
       print("Error: " + result.stderr)
       errors.append(f90_file)
+      out.unlink(missing_ok=True)
     
 
     counter += 1
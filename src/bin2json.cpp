@@ -0,0 +1,51 @@
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/InitLLVM.h>
+#include <llvm/Support/WithColor.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "binary_reader.h"
+#include "json_writer.h"
+
+// Converts a dump in the binary AST format back to the JSON format. The result
+// matches the JSON dump of the same input with compact ids. The -dump-ast-*
+// options that do not change the content, such as the layout, apply.
+
+static llvm::cl::opt<std::string> inputPath(llvm::cl::Positional,
+                                            llvm::cl::desc("<input.bin>"),
+                                            llvm::cl::Required);
+
+static llvm::cl::opt<std::string> outputPath("o",
+                                             llvm::cl::desc("Output file"),
+                                             llvm::cl::value_desc("path"),
+                                             llvm::cl::init("-"));
+
+int main(int argc, char **argv) {
+  llvm::InitLLVM init(argc, argv);
+  llvm::cl::ParseCommandLineOptions(argc, argv,
+                                    "Converts a binary AST dump to JSON\n");
+
+  auto ast = BinaryAst::open(inputPath);
+  if (!ast) {
+    llvm::WithColor::error() << llvm::toString(ast.takeError()) << "\n";
+    return 1;
+  }
+
+  std::error_code error;
+  llvm::raw_fd_ostream os(outputPath, error, llvm::sys::fs::OF_None);
+  if (error) {
+    llvm::WithColor::error()
+        << "cannot open " << outputPath << ": " << error.message() << "\n";
+    return 1;
+  }
+
+  DumpOptions options = DumpOptions::fromCommandLine();
+  options.ids = IdMode::Compact;
+  if (ast->hasSourceRanges())
+    options.source = SourceMode::Ranges;
+  else if (ast->hasSourcePositions())
+    options.source = SourceMode::Positions;
+  JsonWriter out(os, options);
+  replay(*ast, out);
+  return 0;
+}
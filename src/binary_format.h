@@ -0,0 +1,120 @@
+#ifndef __BINARY_FORMAT_H__
+#define __BINARY_FORMAT_H__
+
+#include <cstdint>
+
+// === Binary AST format ===
+//
+// Layout written by the "dump-ast-bin" action. The file starts with a Header
+// that locates each section; every section is an array of fixed-width,
+// little-endian records starting at an 8-byte aligned offset, so the file can
+// be mapped into memory and navigated directly.
+//
+// Nodes are indexed by their compact id (see IdMode::Compact), so references
+// between nodes are plain indices into the node section. Node names, property
+// keys and values are indices into the string table.
+
+namespace ast_binary {
+
+constexpr char magic[8] = {'F', 'D', 'A', 'S', 'T', 'B', 'I', 'N'};
+constexpr std::uint32_t version = 5;
+constexpr std::uint32_t byteOrderMark = 0x01020304;
+
+// Index used for absent nodes and strings
+constexpr std::uint32_t none = 0xffffffff;
+
+struct Section {
+  std::uint64_t offset; // From the start of the file
+  std::uint64_t count;  // Number of records
+};
+
+enum HeaderFlags : std::uint64_t {
+  // Sources are stored as ranges into the source section
+  SourceRanges = 1,
+  // Sources are stored as positions in the original files
+  SourcePositions = 2,
+};
+
+struct Header {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byteOrder;
+  std::uint64_t flags;
+  Section types;      // std::uint32_t, string index of each node name
+  Section nodes;      // NodeRecord, indexed by node id
+  Section order;      // std::uint32_t, node ids in the order they were dumped
+  Section extents;    // ExtentRecord, one per entry of order, or none
+  Section properties; // PropertyRecord
+  Section elements;   // std::uint32_t, node ids of array properties
+  Section strings;    // StringRecord
+  Section stringData; // char, each string is followed by a '\0'
+  Section enums;      // EnumRecord
+  Section enumValues; // std::uint32_t, string index of each enum value
+  Section source;     // char, cooked source of the file
+  Section files;      // std::uint32_t, string index of each original file
+  Section positions;  // PositionRecord
+  std::uint32_t file; // String index of the path of the file, or none
+  std::uint32_t reserved;
+};
+
+enum NodeFlags : std::uint32_t {
+  // The node was dumped. Nodes without this flag are only referenced.
+  Dumped = 1,
+};
+
+struct NodeRecord {
+  std::uint32_t type; // Index into the types section
+  std::uint32_t flags;
+  std::uint32_t firstProperty;
+  std::uint32_t propertyCount;
+};
+
+enum class PropertyKind : std::uint32_t {
+  String, // value is a string index
+  Node,   // value is a node id
+  Null,   // a null id
+  Array,  // value is the first element, count the number of elements
+  Range,  // value is the offset into the source section, count the length
+  Position, // value is the index into the positions section
+};
+
+// Position in the tree of the node at the same index in the order section.
+// The subtree of that node is the entries index to index + size - 1.
+struct ExtentRecord {
+  std::uint32_t parent; // Index into the order section, or none for a root
+  std::uint32_t depth;
+  std::uint32_t size;
+};
+
+// Lines and columns count from 1, the end is the last character. A source
+// that is not from the original files has file none and zeros.
+struct PositionRecord {
+  std::uint32_t file; // Index into the files section
+  std::uint32_t line;
+  std::uint32_t column;
+  std::uint32_t endLine;
+  std::uint32_t endColumn;
+};
+
+struct PropertyRecord {
+  std::uint32_t key; // String index
+  PropertyKind kind;
+  std::uint32_t value;
+  std::uint32_t count;
+};
+
+struct StringRecord {
+  std::uint64_t offset; // Into the stringData section
+  std::uint64_t size;
+};
+
+struct EnumRecord {
+  std::uint32_t name; // String index
+  std::uint32_t firstValue;
+  std::uint32_t valueCount;
+  std::uint32_t reserved;
+};
+
+} // namespace ast_binary
+
+#endif // __BINARY_FORMAT_H__
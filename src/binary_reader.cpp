@@ -0,0 +1,237 @@
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "binary_reader.h"
+
+using namespace ast_binary;
+
+namespace {
+
+llvm::Error malformed(const llvm::Twine &message) {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                 "malformed binary AST: " + message);
+}
+
+// Nodes are passed to the writer as addresses derived from their id
+const void *address(std::uint32_t id) {
+  return reinterpret_cast<const void *>(static_cast<std::uintptr_t>(id) + 1);
+}
+
+} // namespace
+
+llvm::Expected<BinaryAst> BinaryAst::open(llvm::StringRef path) {
+  auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/false,
+                                            /*RequiresNullTerminator=*/false);
+  if (!buffer)
+    return llvm::createStringError(buffer.getError(),
+                                   "cannot open " + path + ": " +
+                                       buffer.getError().message());
+  return fromBuffer(std::move(*buffer));
+}
+
+llvm::Expected<BinaryAst>
+BinaryAst::fromBuffer(std::unique_ptr<llvm::MemoryBuffer> buffer) {
+  BinaryAst ast(std::move(buffer));
+  if (auto error = ast.validate())
+    return error;
+  return ast;
+}
+
+llvm::Error BinaryAst::validate() {
+  const char *data = buffer->getBufferStart();
+  std::uint64_t size = buffer->getBufferSize();
+
+  if (size < sizeof(Header))
+    return malformed("file too small");
+  if (reinterpret_cast<std::uintptr_t>(data) % alignof(Header) != 0)
+    return malformed("buffer is not aligned");
+
+  const auto &header = *reinterpret_cast<const Header *>(data);
+  if (std::memcmp(header.magic, magic, sizeof(magic)) != 0)
+    return malformed("bad magic");
+  if (header.byteOrder != byteOrderMark)
+    return malformed("byte order does not match this machine");
+  if (header.version != version)
+    return malformed("unsupported version " + llvm::Twine(header.version));
+
+  llvm::Error error = llvm::Error::success();
+  auto section = [&](const Section &section, auto &array, const char *name) {
+    using T = typename std::remove_reference_t<decltype(array)>::value_type;
+    if (error)
+      return;
+    if (section.offset % alignof(T) != 0 || section.offset > size ||
+        section.count > (size - section.offset) / sizeof(T)) {
+      error = malformed(llvm::Twine("section ") + name + " out of bounds");
+      return;
+    }
+    array = {reinterpret_cast<const T *>(data + section.offset),
+             static_cast<std::size_t>(section.count)};
+  };
+  section(header.types, types_, "types");
+  section(header.nodes, nodes_, "nodes");
+  section(header.order, order_, "order");
+  section(header.extents, extents_, "extents");
+  section(header.properties, properties_, "properties");
+  section(header.elements, elements_, "elements");
+  section(header.strings, strings_, "strings");
+  section(header.stringData, stringData_, "stringData");
+  section(header.enums, enums_, "enums");
+  section(header.enumValues, enumValues_, "enumValues");
+  section(header.source, source_, "source");
+  section(header.files, files_, "files");
+  section(header.positions, positions_, "positions");
+  flags = header.flags;
+  file_ = header.file;
+  if (error)
+    return error;
+
+  // Check every index once, so the accessors do not need to
+  for (const auto &record : strings_)
+    if (record.offset >= stringData_.size() ||
+        record.size >= stringData_.size() - record.offset ||
+        stringData_[record.offset + record.size] != '\0')
+      return malformed("string out of bounds");
+  if (file_ != none && file_ >= strings_.size())
+    return malformed("bad file name");
+  for (auto type : types_)
+    if (type >= strings_.size())
+      return malformed("bad type name");
+  for (const auto &node : nodes_)
+    if (node.type >= types_.size() ||
+        node.firstProperty > properties_.size() ||
+        node.propertyCount > properties_.size() - node.firstProperty)
+      return malformed("bad node");
+  for (auto id : order_)
+    if (id >= nodes_.size() || !(nodes_[id].flags & Dumped))
+      return malformed("bad node order");
+  if (!extents_.empty() && extents_.size() != order_.size())
+    return malformed("extents do not match the node order");
+  for (std::size_t i = 0; i < extents_.size(); ++i) {
+    const auto &extent = extents_[i];
+    if ((extent.parent != none && extent.parent >= i) || extent.size == 0 ||
+        extent.size > extents_.size() - i)
+      return malformed("bad extent");
+  }
+  for (const auto &property : properties_) {
+    if (property.key >= strings_.size())
+      return malformed("bad property key");
+    switch (property.kind) {
+    case PropertyKind::String:
+      if (property.value >= strings_.size())
+        return malformed("bad property value");
+      break;
+    case PropertyKind::Node:
+      if (property.value >= nodes_.size())
+        return malformed("bad node reference");
+      break;
+    case PropertyKind::Null:
+      break;
+    case PropertyKind::Range:
+      if (property.value > source_.size() ||
+          property.count > source_.size() - property.value)
+        return malformed("bad source range");
+      break;
+    case PropertyKind::Position:
+      if (property.value >= positions_.size())
+        return malformed("bad source position");
+      break;
+    case PropertyKind::Array:
+      if (property.value > elements_.size() ||
+          property.count > elements_.size() - property.value)
+        return malformed("bad array");
+      break;
+    default:
+      return malformed("bad property kind");
+    }
+  }
+  for (auto element : elements_)
+    if (element != none && element >= nodes_.size())
+      return malformed("bad array element");
+  for (auto file : files_)
+    if (file >= strings_.size())
+      return malformed("bad file name");
+  for (const auto &position : positions_)
+    if (position.file != none && position.file >= files_.size())
+      return malformed("bad position file");
+  for (const auto &record : enums_)
+    if (record.name >= strings_.size() ||
+        record.firstValue > enumValues_.size() ||
+        record.valueCount > enumValues_.size() - record.firstValue)
+      return malformed("bad enum");
+  for (auto value : enumValues_)
+    if (value >= strings_.size())
+      return malformed("bad enum value");
+
+  return llvm::Error::success();
+}
+
+void replay(const BinaryAst &ast, NodeWriter &out) {
+  auto id = [&](std::uint32_t id) {
+    if (id == none)
+      out.nullId();
+    else
+      out.id(address(id), ast.typeName(ast.node(id)));
+  };
+
+  std::vector<EnumEntry> enums;
+  enums.reserve(ast.enums().size());
+  for (const auto &record : ast.enums()) {
+    auto &entry = enums.emplace_back();
+    entry.name = ast.string(record.name);
+    for (auto value : ast.values(record))
+      entry.values.push_back(ast.string(value));
+  }
+
+  std::vector<std::string> files;
+  for (auto file : ast.files())
+    files.push_back(ast.string(file).str());
+
+  EnumSchema schema(std::move(enums));
+  auto source = ast.source();
+  out.beginDocument({std::string_view{source.data(), source.size()},
+                     std::string_view{ast.file()}, schema, files});
+  for (auto nodeId : ast.order()) {
+    const auto &node = ast.node(nodeId);
+    out.beginNode(address(nodeId), ast.typeName(node));
+    for (const auto &property : ast.properties(node)) {
+      out.key(ast.string(property.key));
+      switch (property.kind) {
+      case PropertyKind::String:
+        out.value(std::string_view{ast.string(property.value)});
+        break;
+      case PropertyKind::Range:
+        out.source(std::string_view{source.data() + property.value,
+                                    property.count});
+        break;
+      case PropertyKind::Position: {
+        const auto &position = ast.position(property);
+        out.position({position.file, position.line, position.column,
+                      position.endLine, position.endColumn});
+        break;
+      }
+      case PropertyKind::Node:
+      case PropertyKind::Null:
+        id(property.value);
+        break;
+      case PropertyKind::Array:
+        out.beginArray();
+        for (auto element : ast.elements(property)) {
+          out.element();
+          id(element);
+        }
+        out.endArray();
+        break;
+      }
+    }
+    out.endNode();
+  }
+
+  std::vector<NodeExtent> extents;
+  extents.reserve(ast.extents().size());
+  for (const auto &record : ast.extents())
+    extents.push_back({record.parent, record.depth, record.size});
+  if (!extents.empty())
+    out.extents(extents);
+  out.endDocument();
+}
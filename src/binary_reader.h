@@ -0,0 +1,111 @@
+#ifndef __BINARY_READER_H__
+#define __BINARY_READER_H__
+
+#include <cstdint>
+#include <memory>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+#include "binary_format.h"
+#include "node_writer.h"
+
+// === BinaryAst class ===
+//
+// Read-only view of a file in the binary AST format. The file is mapped into
+// memory and validated once when opened; the accessors then index straight
+// into the mapped sections.
+
+class BinaryAst {
+public:
+  static llvm::Expected<BinaryAst> open(llvm::StringRef path);
+  static llvm::Expected<BinaryAst>
+  fromBuffer(std::unique_ptr<llvm::MemoryBuffer> buffer);
+
+  llvm::ArrayRef<ast_binary::NodeRecord> nodes() const { return nodes_; }
+  llvm::ArrayRef<std::uint32_t> order() const { return order_; }
+  // Empty if the extents were not dumped
+  llvm::ArrayRef<ast_binary::ExtentRecord> extents() const {
+    return extents_;
+  }
+  llvm::ArrayRef<ast_binary::EnumRecord> enums() const { return enums_; }
+
+  // Path of the dumped file, empty if it was not known
+  llvm::StringRef file() const {
+    return file_ == ast_binary::none ? llvm::StringRef{} : string(file_);
+  }
+
+  bool hasSourceRanges() const { return flags & ast_binary::SourceRanges; }
+  llvm::StringRef source() const { return {source_.data(), source_.size()}; }
+
+  bool hasSourcePositions() const {
+    return flags & ast_binary::SourcePositions;
+  }
+  // String indices of the original files
+  llvm::ArrayRef<std::uint32_t> files() const { return files_; }
+  const ast_binary::PositionRecord &
+  position(const ast_binary::PropertyRecord &property) const {
+    return positions_[property.value];
+  }
+
+  const ast_binary::NodeRecord &node(std::uint32_t id) const {
+    return nodes_[id];
+  }
+
+  llvm::StringRef typeName(const ast_binary::NodeRecord &node) const {
+    return string(types_[node.type]);
+  }
+
+  llvm::ArrayRef<ast_binary::PropertyRecord>
+  properties(const ast_binary::NodeRecord &node) const {
+    return properties_.slice(node.firstProperty, node.propertyCount);
+  }
+
+  llvm::ArrayRef<std::uint32_t>
+  elements(const ast_binary::PropertyRecord &property) const {
+    return elements_.slice(property.value, property.count);
+  }
+
+  llvm::ArrayRef<std::uint32_t>
+  values(const ast_binary::EnumRecord &record) const {
+    return enumValues_.slice(record.firstValue, record.valueCount);
+  }
+
+  // Strings are '\0' terminated
+  llvm::StringRef string(std::uint32_t index) const {
+    const auto &record = strings_[index];
+    return {stringData_.data() + record.offset, record.size};
+  }
+
+private:
+  explicit BinaryAst(std::unique_ptr<llvm::MemoryBuffer> buffer)
+      : buffer(std::move(buffer)) {}
+
+  llvm::Error validate();
+
+  std::unique_ptr<llvm::MemoryBuffer> buffer;
+  llvm::ArrayRef<std::uint32_t> types_;
+  llvm::ArrayRef<ast_binary::NodeRecord> nodes_;
+  llvm::ArrayRef<std::uint32_t> order_;
+  llvm::ArrayRef<ast_binary::ExtentRecord> extents_;
+  llvm::ArrayRef<ast_binary::PropertyRecord> properties_;
+  llvm::ArrayRef<std::uint32_t> elements_;
+  llvm::ArrayRef<ast_binary::StringRecord> strings_;
+  llvm::ArrayRef<char> stringData_;
+  llvm::ArrayRef<ast_binary::EnumRecord> enums_;
+  llvm::ArrayRef<std::uint32_t> enumValues_;
+  llvm::ArrayRef<char> source_;
+  llvm::ArrayRef<std::uint32_t> files_;
+  llvm::ArrayRef<ast_binary::PositionRecord> positions_;
+  std::uint64_t flags = 0;
+  std::uint32_t file_ = ast_binary::none;
+};
+
+// Replays the dumped nodes into another writer, in their original order. With
+// a JsonWriter using compact ids and the same source mode, this reproduces
+// the JSON dump of the same input.
+void replay(const BinaryAst &ast, NodeWriter &out);
+
+#endif // __BINARY_READER_H__
@@ -0,0 +1,264 @@
+#include <cstddef>
+#include <cstring>
+
+#include "binary_writer.h"
+
+using namespace ast_binary;
+
+namespace {
+
+constexpr std::uint64_t align(std::uint64_t offset) {
+  return (offset + 7) & ~std::uint64_t{7};
+}
+
+// Places the sections one after the other, after the header
+static_assert(sizeof(NodeExtent) == sizeof(ExtentRecord) &&
+                  offsetof(NodeExtent, parent) ==
+                      offsetof(ExtentRecord, parent) &&
+                  offsetof(NodeExtent, depth) == offsetof(ExtentRecord, depth) &&
+                  offsetof(NodeExtent, size) == offsetof(ExtentRecord, size) &&
+                  NodeExtent::noParent == none,
+              "extents are written as they are recorded");
+
+class Layout {
+public:
+  template <typename T> Section add(std::uint64_t count) {
+    Section section{align(end), count};
+    end = section.offset + count * sizeof(T);
+    return section;
+  }
+
+  std::uint64_t end = sizeof(Header);
+};
+
+class SectionWriter {
+public:
+  explicit SectionWriter(llvm::raw_ostream &os) : os(os) {}
+
+  void write(const void *data, std::uint64_t size) {
+    os.write(static_cast<const char *>(data), size);
+    written += size;
+  }
+
+  template <typename T> void write(const Section &section, const T *data) {
+    pad(section.offset);
+    write(data, section.count * sizeof(T));
+  }
+
+  void pad(std::uint64_t offset) {
+    static constexpr char zeros[8] = {};
+    write(zeros, offset - written);
+  }
+
+  llvm::raw_ostream &os;
+  std::uint64_t written = 0;
+};
+
+} // namespace
+
+void BinaryWriter::beginNode(const void *address, std::string_view name) {
+  currentNode = node(address, name);
+  auto &record = nodes[currentNode];
+  record.flags |= Dumped;
+  record.firstProperty = properties.size();
+  order.push_back(currentNode);
+}
+
+void BinaryWriter::endNode() {
+  auto &record = nodes[currentNode];
+  record.propertyCount = properties.size() - record.firstProperty;
+  currentNode = none;
+}
+
+void BinaryWriter::key(std::string_view name, std::string_view argument) {
+  scratch.assign(name);
+  scratch += '<';
+  scratch += argument;
+  scratch += '>';
+  pendingKey = string(scratch);
+}
+
+void BinaryWriter::value(std::uint64_t v) {
+  char digits[20];
+  char *end = digits + sizeof(digits);
+  char *p = end;
+  do {
+    *--p = static_cast<char>('0' + v % 10);
+    v /= 10;
+  } while (v != 0);
+  value(std::string_view(p, end - p));
+}
+
+void BinaryWriter::value(int v) {
+  if (v >= 0) {
+    value(static_cast<std::uint64_t>(v));
+    return;
+  }
+  scratch = std::to_string(v);
+  value(std::string_view{scratch});
+}
+
+void BinaryWriter::source(std::string_view text) {
+  if (sourceMode == SourceMode::Positions && locator) {
+    position(locator->locate(text, cursor));
+    return;
+  }
+  // Ranges are 32-bit, so the text of a source of 4 GiB or more is written
+  // where a range would not fit
+  if (sourceMode == SourceMode::Ranges && text.data() >= document.data() &&
+      text.data() + text.size() <= document.data() + document.size() &&
+      std::uint64_t(text.data() - document.data()) + text.size() <= none) {
+    properties.push_back({pendingKey, PropertyKind::Range,
+                          std::uint32_t(text.data() - document.data()),
+                          std::uint32_t(text.size())});
+    pendingKey = none;
+    return;
+  }
+  value(text);
+}
+
+void BinaryWriter::position(const SourceRange &range) {
+  static_assert(SourceRange::noFile == none, "positions without a file");
+  property(PropertyKind::Position, positions.size());
+  positions.push_back({range.file, range.line, range.column, range.endLine,
+                       range.endColumn});
+}
+
+void BinaryWriter::id(const void *address, std::string_view name) {
+  std::uint32_t index = node(address, name);
+  if (currentArray != none)
+    elements.push_back(index);
+  else
+    property(PropertyKind::Node, index);
+}
+
+void BinaryWriter::nullId() {
+  if (currentArray != none)
+    elements.push_back(none);
+  else
+    property(PropertyKind::Null, none);
+}
+
+void BinaryWriter::beginArray() {
+  property(PropertyKind::Array, elements.size());
+  currentArray = properties.size() - 1;
+}
+
+void BinaryWriter::endArray() {
+  auto &record = properties[currentArray];
+  record.count = elements.size() - record.value;
+  currentArray = none;
+}
+
+std::uint64_t BinaryWriter::bytesWritten() const {
+  return types.size() * sizeof(std::uint32_t) +
+         nodes.size() * sizeof(NodeRecord) +
+         order.size() * sizeof(std::uint32_t) +
+         properties.size() * sizeof(PropertyRecord) +
+         elements.size() * sizeof(std::uint32_t) +
+         positions.size() * sizeof(PositionRecord) + stringBytes;
+}
+
+std::uint32_t BinaryWriter::node(const void *address, std::string_view name) {
+  std::uint32_t index = ids.get(address, name);
+  if (index == nodes.size())
+    nodes.push_back({type(name), 0, 0, 0});
+  return index;
+}
+
+std::uint32_t BinaryWriter::string(llvm::StringRef s) {
+  auto [it, inserted] = stringIndices.try_emplace(s, strings.size());
+  if (inserted) {
+    strings.push_back(&*it);
+    stringBytes += sizeof(StringRecord) + s.size() + 1;
+  }
+  return it->second;
+}
+
+std::uint32_t BinaryWriter::type(llvm::StringRef name) {
+  auto [it, inserted] = typeIndices.try_emplace(name, types.size());
+  if (inserted)
+    types.push_back(string(name));
+  return it->second;
+}
+
+void BinaryWriter::property(PropertyKind kind, std::uint32_t value) {
+  properties.push_back({pendingKey, kind, value, 0});
+  pendingKey = none;
+}
+
+void BinaryWriter::endDocument() {
+  std::vector<EnumRecord> enumRecords;
+  std::vector<std::uint32_t> enumValues;
+  for (const auto &[name, values] : enums) {
+    enumRecords.push_back({string(name), std::uint32_t(enumValues.size()),
+                           std::uint32_t(values.size()), 0});
+    for (auto value : values)
+      enumValues.push_back(string(value));
+  }
+
+  std::uint32_t fileName = file.empty() ? none : string(file);
+  std::vector<std::uint32_t> fileNames;
+  if (sourceMode == SourceMode::Positions)
+    for (const auto &file : files)
+      fileNames.push_back(string(file));
+
+  std::vector<StringRecord> stringRecords;
+  stringRecords.reserve(strings.size());
+  std::uint64_t stringDataSize = 0;
+  for (const auto *entry : strings) {
+    stringRecords.push_back({stringDataSize, entry->getKeyLength()});
+    stringDataSize += entry->getKeyLength() + 1;
+  }
+
+  Header header;
+  std::memcpy(header.magic, magic, sizeof(magic));
+  header.version = version;
+  header.byteOrder = byteOrderMark;
+  header.flags = 0;
+  if (sourceMode == SourceMode::Ranges)
+    header.flags = SourceRanges;
+  else if (sourceMode == SourceMode::Positions)
+    header.flags = SourcePositions;
+  header.file = fileName;
+  header.reserved = 0;
+  std::string_view source =
+      sourceMode == SourceMode::Ranges ? document : std::string_view{};
+
+  Layout layout;
+  header.types = layout.add<std::uint32_t>(types.size());
+  header.nodes = layout.add<NodeRecord>(nodes.size());
+  header.order = layout.add<std::uint32_t>(order.size());
+  header.extents = layout.add<ExtentRecord>(nodeExtents.size());
+  header.properties = layout.add<PropertyRecord>(properties.size());
+  header.elements = layout.add<std::uint32_t>(elements.size());
+  header.strings = layout.add<StringRecord>(stringRecords.size());
+  header.stringData = layout.add<char>(stringDataSize);
+  header.enums = layout.add<EnumRecord>(enumRecords.size());
+  header.enumValues = layout.add<std::uint32_t>(enumValues.size());
+  header.source = layout.add<char>(source.size());
+  header.files = layout.add<std::uint32_t>(fileNames.size());
+  header.positions = layout.add<PositionRecord>(positions.size());
+
+  SectionWriter out(os);
+  out.write(&header, sizeof(header));
+  out.write(header.types, types.data());
+  out.write(header.nodes, nodes.data());
+  out.write(header.order, order.data());
+  out.write(header.extents, nodeExtents.data());
+  out.write(header.properties, properties.data());
+  out.write(header.elements, elements.data());
+  out.write(header.strings, stringRecords.data());
+  out.pad(header.stringData.offset);
+  for (const auto *entry : strings) {
+    out.write(entry->getKeyData(), entry->getKeyLength());
+    out.write("", 1);
+  }
+  out.write(header.enums, enumRecords.data());
+  out.write(header.enumValues, enumValues.data());
+  out.write(header.source, source.data());
+  out.write(header.files, fileNames.data());
+  out.write(header.positions, positions.data());
+  out.pad(align(out.written));
+  os.flush();
+}
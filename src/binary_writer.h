@@ -0,0 +1,110 @@
+#ifndef __BINARY_WRITER_H__
+#define __BINARY_WRITER_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "binary_format.h"
+#include "node_ids.h"
+#include "node_writer.h"
+#include "options.h"
+
+// === BinaryWriter class ===
+//
+// Collects the dumped graph into the tables of the binary AST format (see
+// binary_format.h) and writes them when the document ends. Strings are
+// interned, so every name, key and piece of source text is stored once. With
+// source ranges, the source of the file is stored instead and nodes refer to
+// ranges of it. With source positions, nodes refer to position records.
+
+class BinaryWriter final : public NodeWriter {
+public:
+  explicit BinaryWriter(llvm::raw_ostream &os, const DumpOptions &options = {})
+      : os(os), sourceMode(options.source) {}
+
+  // Document
+  void beginDocument(const Document &document) override {
+    this->document = document.source;
+    file = document.file;
+    enums = document.schema.enums();
+    files = document.files;
+    locator = document.locator;
+  }
+  void endDocument() override;
+
+  // Nodes
+  void beginNode(const void *address, std::string_view name) override;
+  void endNode() override;
+
+  // Properties
+  void key(std::string_view name) override { pendingKey = string(name); }
+  void key(std::string_view name, std::string_view argument) override;
+
+  using NodeWriter::value;
+  void value(std::string_view v) override {
+    property(ast_binary::PropertyKind::String, string(v));
+  }
+  void value(std::uint64_t v) override;
+  void value(int v) override;
+  void value(bool v) override { value(v ? "1" : "0"); }
+
+  void source(std::string_view text) override;
+  void position(const SourceRange &range) override;
+
+  void id(const void *address, std::string_view name) override;
+  void nullId() override;
+
+  // Arrays of ids
+  void beginArray() override;
+  void element() override {}
+  void endArray() override;
+
+  // Written when the document ends
+  void extents(llvm::ArrayRef<NodeExtent> extents) override {
+    nodeExtents = extents;
+  }
+
+  // Size of the records built so far, the file is written when the document
+  // ends
+  std::uint64_t bytesWritten() const override;
+
+private:
+  std::uint32_t node(const void *address, std::string_view name);
+  std::uint32_t string(llvm::StringRef s);
+  std::uint32_t type(llvm::StringRef name);
+  void property(ast_binary::PropertyKind kind, std::uint32_t value);
+
+  llvm::raw_ostream &os;
+  SourceMode sourceMode;
+  std::string_view document;
+  std::string_view file;
+  llvm::ArrayRef<EnumEntry> enums;
+  llvm::ArrayRef<std::string> files;
+  const SourceLocator *locator = nullptr;
+  std::size_t cursor = 0; // Of locator
+  NodeIds ids;
+
+  std::vector<std::uint32_t> types;
+  std::vector<ast_binary::NodeRecord> nodes;
+  std::vector<std::uint32_t> order;
+  llvm::ArrayRef<NodeExtent> nodeExtents;
+  std::vector<ast_binary::PropertyRecord> properties;
+  std::vector<std::uint32_t> elements;
+  std::vector<ast_binary::PositionRecord> positions;
+
+  llvm::StringMap<std::uint32_t> stringIndices;
+  std::vector<const llvm::StringMapEntry<std::uint32_t> *> strings;
+  std::uint64_t stringBytes = 0;
+  llvm::StringMap<std::uint32_t> typeIndices;
+
+  std::uint32_t currentNode = ast_binary::none;
+  std::uint32_t pendingKey = ast_binary::none;
+  std::uint32_t currentArray = ast_binary::none;
+  std::string scratch;
+};
+
+#endif // __BINARY_WRITER_H__
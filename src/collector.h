@@ -1,7 +1,10 @@
 #ifndef __COLLECTOR_H__
 #define __COLLECTOR_H__
 
+#include <cstddef>
 #include <functional>
+#include <mutex>
+#include <string_view>
 #include <vector>
 
 #define CONCAT_(a, b) a##b
@@ -10,12 +13,22 @@
 // === Collector class ===
 
 template <typename Owner> struct Collector {
-  using EnumDumpFunc = void (*)();
-  static inline std::vector<std::pair<const char *, EnumDumpFunc>> registry;
+  // Returns the name of the i-th value of an enum
+  using EnumNameFunc = std::string_view (*)(std::size_t);
+
+  struct Entry {
+    const char *name;
+    std::size_t size;
+    EnumNameFunc enumerator;
+  };
+
+  static inline std::vector<Entry> registry;
+  static inline std::mutex mutex;
 
   struct Registrar {
-    Registrar(const char *name, EnumDumpFunc func) {
-      Collector<Owner>::registry.emplace_back(name, func);
+    Registrar(const char *name, std::size_t size, EnumNameFunc func) {
+      std::lock_guard<std::mutex> lock(Collector<Owner>::mutex);
+      Collector<Owner>::registry.push_back({name, size, func});
     }
   };
 
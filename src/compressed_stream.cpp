@@ -0,0 +1,243 @@
+#include <vector>
+
+#include <llvm/Support/ErrorHandling.h>
+
+#ifdef DUMP_AST_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef DUMP_AST_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "compressed_stream.h"
+
+// === CompressedStream::Codec class ===
+
+class CompressedStream::Codec {
+public:
+  virtual ~Codec() = default;
+
+  // Compresses `data` into `os`
+  virtual void compress(llvm::StringRef data, llvm::raw_ostream &os) = 0;
+  // Flushes the codec and ends the compressed data
+  virtual void finish(llvm::raw_ostream &os) = 0;
+};
+
+namespace {
+
+[[maybe_unused]] llvm::Error levelError(llvm::StringRef codec, int level,
+                                        int min, int max) {
+  return llvm::createStringError(
+      llvm::inconvertibleErrorCode(),
+      "compression level %d is out of range for %s (%d to %d, or 0 for the "
+      "default)",
+      level, codec.str().c_str(), min, max);
+}
+
+#ifdef DUMP_AST_HAVE_ZLIB
+// Writes a gzip member, so the output can be read with gunzip
+class ZlibCodec final : public CompressedStream::Codec {
+public:
+  ZlibCodec() : buffer(bufferSize) {}
+  ~ZlibCodec() override { deflateEnd(&stream); }
+
+  static llvm::Expected<std::unique_ptr<CompressedStream::Codec>>
+  create(int level) {
+    if (level < 0 || level > Z_BEST_COMPRESSION)
+      return levelError("zlib", level, Z_BEST_SPEED, Z_BEST_COMPRESSION);
+    auto codec = std::make_unique<ZlibCodec>();
+    // 15 bits of window, +16 for a gzip header and trailer
+    if (deflateInit2(&codec->stream,
+                     level == 0 ? Z_DEFAULT_COMPRESSION : level, Z_DEFLATED,
+                     15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "cannot initialize zlib");
+    return codec;
+  }
+
+  void compress(llvm::StringRef data, llvm::raw_ostream &os) override {
+    // avail_in is 32-bit
+    while (!data.empty()) {
+      auto chunk = data.take_front(1u << 30);
+      data = data.drop_front(chunk.size());
+      stream.next_in =
+          reinterpret_cast<Bytef *>(const_cast<char *>(chunk.data()));
+      stream.avail_in = chunk.size();
+      deflateAll(Z_NO_FLUSH, os);
+    }
+  }
+
+  void finish(llvm::raw_ostream &os) override { deflateAll(Z_FINISH, os); }
+
+private:
+  static constexpr std::size_t bufferSize = 1 << 16;
+
+  void deflateAll(int flush, llvm::raw_ostream &os) {
+    int status;
+    do {
+      stream.next_out = reinterpret_cast<Bytef *>(buffer.data());
+      stream.avail_out = buffer.size();
+      status = deflate(&stream, flush);
+      os.write(buffer.data(), buffer.size() - stream.avail_out);
+    } while (flush == Z_FINISH ? status != Z_STREAM_END
+                               : stream.avail_out == 0);
+  }
+
+  z_stream stream{};
+  std::vector<char> buffer;
+};
+#endif
+
+#ifdef DUMP_AST_HAVE_ZSTD
+class ZstdCodec final : public CompressedStream::Codec {
+public:
+  ZstdCodec() : context(ZSTD_createCCtx()), buffer(ZSTD_CStreamOutSize()) {}
+  ~ZstdCodec() override { ZSTD_freeCCtx(context); }
+
+  static llvm::Expected<std::unique_ptr<CompressedStream::Codec>>
+  create(int level, unsigned threads) {
+    if (level < ZSTD_minCLevel() || level > ZSTD_maxCLevel())
+      return levelError("zstd", level, ZSTD_minCLevel(), ZSTD_maxCLevel());
+    auto codec = std::make_unique<ZstdCodec>();
+    if (!codec->context)
+      return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                     "cannot initialize zstd");
+    if (level != 0)
+      ZSTD_CCtx_setParameter(codec->context, ZSTD_c_compressionLevel, level);
+    // Fails, and compresses on the calling thread, if libzstd is built
+    // without multithreading
+    if (threads > 0)
+      ZSTD_CCtx_setParameter(codec->context, ZSTD_c_nbWorkers, threads);
+    return codec;
+  }
+
+  void compress(llvm::StringRef data, llvm::raw_ostream &os) override {
+    ZSTD_inBuffer input{data.data(), data.size(), 0};
+    while (input.pos < input.size)
+      compressStream(input, ZSTD_e_continue, os);
+  }
+
+  void finish(llvm::raw_ostream &os) override {
+    ZSTD_inBuffer input{nullptr, 0, 0};
+    while (compressStream(input, ZSTD_e_end, os) != 0) {
+    }
+  }
+
+private:
+  // Returns what is left to flush
+  std::size_t compressStream(ZSTD_inBuffer &input, ZSTD_EndDirective mode,
+                             llvm::raw_ostream &os) {
+    ZSTD_outBuffer output{buffer.data(), buffer.size(), 0};
+    std::size_t remaining =
+        ZSTD_compressStream2(context, &output, &input, mode);
+    if (ZSTD_isError(remaining))
+      llvm::report_fatal_error(llvm::Twine("zstd: ") +
+                               ZSTD_getErrorName(remaining));
+    os.write(buffer.data(), output.pos);
+    return remaining;
+  }
+
+  ZSTD_CCtx *context;
+  std::vector<char> buffer;
+};
+#endif
+
+} // namespace
+
+Compression
+CompressedStream::available([[maybe_unused]] Compression requested) {
+#ifdef DUMP_AST_HAVE_ZSTD
+  if (requested == Compression::Zstd)
+    return Compression::Zstd;
+#endif
+#ifdef DUMP_AST_HAVE_ZLIB
+  if (requested != Compression::None)
+    return Compression::Zlib;
+#endif
+  return Compression::None;
+}
+
+llvm::StringRef CompressedStream::extension(Compression compression) {
+  switch (compression) {
+  case Compression::None:
+    return "";
+  case Compression::Zlib:
+    return ".gz";
+  case Compression::Zstd:
+    return ".zst";
+  }
+  llvm_unreachable("unknown compression");
+}
+
+llvm::Expected<std::unique_ptr<CompressedStream>>
+CompressedStream::create(llvm::raw_ostream &os, Compression compression,
+                         [[maybe_unused]] int level,
+                         [[maybe_unused]] unsigned threads) {
+  llvm::Expected<std::unique_ptr<Codec>> codec = nullptr;
+  switch (available(compression)) {
+#ifdef DUMP_AST_HAVE_ZSTD
+  case Compression::Zstd:
+    codec = ZstdCodec::create(level, threads);
+    break;
+#endif
+#ifdef DUMP_AST_HAVE_ZLIB
+  case Compression::Zlib:
+    codec = ZlibCodec::create(level);
+    break;
+#endif
+  default:
+    break;
+  }
+  if (!codec)
+    return codec.takeError();
+  return std::unique_ptr<CompressedStream>(
+      new CompressedStream(os, std::move(*codec)));
+}
+
+CompressedStream::CompressedStream(llvm::raw_ostream &os,
+                                   std::unique_ptr<Codec> codec)
+    : os(os), codec(std::move(codec)) {
+  SetUnbuffered();
+}
+
+CompressedStream::~CompressedStream() { finish(); }
+
+void CompressedStream::finish() {
+  if (finished)
+    return;
+  flush();
+  finished = true;
+  if (codec)
+    codec->finish(os);
+}
+
+void CompressedStream::write_impl(const char *ptr, std::size_t size) {
+  written += size;
+  if (codec)
+    codec->compress({ptr, size}, os);
+  else
+    os.write(ptr, size);
+}
+
+llvm::Error
+writeCompressed(llvm::raw_ostream &os, const DumpOptions &options,
+                llvm::function_ref<void(llvm::raw_ostream &)> write) {
+  Compression compression = CompressedStream::available(options.compression);
+  if (compression != options.compression)
+    llvm::errs() << "warning: the requested compression is not built in, "
+                    "using "
+                 << (compression == Compression::None ? "none" : "zlib")
+                 << " instead\n";
+  if (compression == Compression::None) {
+    write(os);
+    return llvm::Error::success();
+  }
+  auto stream = CompressedStream::create(os, compression,
+                                         options.compressionLevel,
+                                         options.compressionThreads);
+  if (!stream)
+    return stream.takeError();
+  write(**stream);
+  (*stream)->finish();
+  return llvm::Error::success();
+}
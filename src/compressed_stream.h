@@ -0,0 +1,63 @@
+#ifndef __COMPRESSED_STREAM_H__
+#define __COMPRESSED_STREAM_H__
+
+#include <cstdint>
+#include <memory>
+
+#include <llvm/ADT/STLFunctionalExtras.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "options.h"
+
+// === CompressedStream class ===
+//
+// Compresses everything written to it into another stream, as a zstd frame or
+// a gzip member, so the dump reaches the disk already compressed. Codecs are
+// optional at build time (DUMP_AST_HAVE_ZSTD, DUMP_AST_HAVE_ZLIB); zstd falls
+// back to zlib when it is missing.
+//
+// The stream is unbuffered: the writers already hand over large blocks, which
+// go straight to the codec.
+
+class CompressedStream final : public llvm::raw_ostream {
+public:
+  // Compression used for `requested` in this build, None if no codec is
+  // available
+  static Compression available(Compression requested);
+
+  // Extension of the files compressed with `compression`, e.g. ".zst"
+  static llvm::StringRef extension(Compression compression);
+
+  // `level` 0 is the default level of the codec. `threads` above 0 compresses
+  // on that many worker threads, with zstd only. Fails if `level` is out of
+  // the range of the codec used, or if the codec cannot be initialized.
+  static llvm::Expected<std::unique_ptr<CompressedStream>>
+  create(llvm::raw_ostream &os, Compression compression, int level,
+         unsigned threads);
+  ~CompressedStream() override;
+
+  // Ends the compressed data. Nothing can be written afterwards.
+  void finish();
+
+  class Codec;
+
+private:
+  CompressedStream(llvm::raw_ostream &os, std::unique_ptr<Codec> codec);
+
+  void write_impl(const char *ptr, std::size_t size) override;
+  std::uint64_t current_pos() const override { return written; }
+
+  llvm::raw_ostream &os;
+  std::unique_ptr<Codec> codec;
+  std::uint64_t written = 0;
+  bool finished = false;
+};
+
+// Runs `write` on `os`, through a CompressedStream if the options ask for one.
+// Nothing is written if the stream cannot be created.
+llvm::Error writeCompressed(llvm::raw_ostream &os, const DumpOptions &options,
+                            llvm::function_ref<void(llvm::raw_ostream &)> write);
+
+#endif // __COMPRESSED_STREAM_H__
@@ -0,0 +1,45 @@
+#include <algorithm>
+
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/LineIterator.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "corpus.h"
+
+void collectSources(llvm::StringRef path, llvm::StringRef extension,
+                    std::vector<std::string> &files) {
+  if (!llvm::sys::fs::is_directory(path)) {
+    files.push_back(path.str());
+    return;
+  }
+
+  std::size_t first = files.size();
+  std::error_code ec;
+  for (llvm::sys::fs::recursive_directory_iterator it(path, ec), end;
+       it != end && !ec; it.increment(ec)) {
+    llvm::StringRef file = it->path();
+    llvm::StringRef fileExtension = llvm::sys::path::extension(file);
+    if (!fileExtension.consume_front(".") || fileExtension != extension ||
+        llvm::sys::fs::is_directory(file))
+      continue;
+    files.push_back(file.str());
+  }
+  if (ec)
+    llvm::errs() << path << ": " << ec.message() << "\n";
+
+  // Directory order depends on the file system
+  std::sort(files.begin() + first, files.end());
+}
+
+bool readPathList(llvm::StringRef listPath, std::vector<std::string> &paths) {
+  auto buffer = llvm::MemoryBuffer::getFile(listPath);
+  if (!buffer) {
+    llvm::errs() << listPath << ": " << buffer.getError().message() << "\n";
+    return false;
+  }
+  for (llvm::line_iterator line(**buffer); !line.is_at_end(); ++line)
+    paths.push_back(line->trim().str());
+  return true;
+}
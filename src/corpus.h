@@ -0,0 +1,19 @@
+#ifndef __CORPUS_H__
+#define __CORPUS_H__
+
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/StringRef.h>
+
+// Adds `path` to `files` if it is a file. If it is a directory, adds the files
+// found in it recursively whose extension is `extension` (without the dot).
+// Errors are reported to stderr.
+void collectSources(llvm::StringRef path, llvm::StringRef extension,
+                    std::vector<std::string> &files);
+
+// Adds the paths listed in the file at `listPath`, one per line, to `paths`.
+// Returns false if it cannot be read.
+bool readPathList(llvm::StringRef listPath, std::vector<std::string> &paths);
+
+#endif // __CORPUS_H__
@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <string>
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/xxhash.h>
+
+#include "dag_writer.h"
+
+namespace {
+
+constexpr std::uint32_t none = 0xffffffff;
+
+template <typename T> void append(std::string &bytes, const T &value) {
+  bytes.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void append(std::string &bytes, llvm::StringRef text) {
+  bytes.append(text.data(), text.size());
+  bytes += '\0';
+}
+
+} // namespace
+
+std::uint32_t DagWriter::intern(std::string_view text) {
+  auto [it, inserted] = stringIndex.try_emplace(
+      llvm::StringRef{text.data(), text.size()}, strings.size());
+  if (inserted)
+    strings.push_back(it->first());
+  return it->second;
+}
+
+void DagWriter::beginNode(const void *address, std::string_view name) {
+  nodes.push_back({address, intern(name),
+                   static_cast<std::uint32_t>(events.size())});
+}
+
+void DagWriter::endNode() {}
+
+void DagWriter::key(std::string_view name) {
+  record(EventKind::Key, intern(name));
+}
+
+void DagWriter::key(std::string_view name, std::string_view argument) {
+  record(EventKind::KeyArgument, intern(name), intern(argument));
+}
+
+void DagWriter::value(std::string_view v) {
+  record(EventKind::String, intern(v));
+}
+
+void DagWriter::value(std::uint64_t v) { record(EventKind::UInt, 0, v); }
+
+void DagWriter::value(int v) {
+  record(EventKind::Int, 0, static_cast<std::uint64_t>(v));
+}
+
+void DagWriter::value(bool v) { record(EventKind::Bool, 0, v); }
+
+// Views into the source of the document, or into module files for symbols,
+// which outlive the document
+void DagWriter::source(std::string_view text) {
+  record(EventKind::Source, sources.size());
+  sources.push_back(text);
+}
+
+void DagWriter::position(const SourceRange &range) {
+  record(EventKind::Position, ranges.size());
+  ranges.push_back(range);
+}
+
+void DagWriter::id(const void *address, std::string_view name) {
+  record(EventKind::Id, intern(name), reinterpret_cast<std::uintptr_t>(address));
+}
+
+void DagWriter::nullId() { record(EventKind::NullId); }
+
+void DagWriter::beginArray() { record(EventKind::BeginArray); }
+
+void DagWriter::element() { record(EventKind::Element); }
+
+void DagWriter::endArray() { record(EventKind::EndArray); }
+
+std::uint32_t DagWriter::find(const Event &id) const {
+  auto it = byAddress.find(
+      {reinterpret_cast<const void *>(id.value), id.index});
+  return it == byAddress.end() ? none : it->second;
+}
+
+// Nodes of a replaced subtree map to their counterpart, which may itself be
+// in a replaced subtree, but always comes before them
+std::uint32_t DagWriter::resolve(std::uint32_t node) const {
+  while (node < replaced.size() && !replaced[node] && sameAs[node] != none)
+    node = sameAs[node];
+  return node;
+}
+
+void DagWriter::hashSubtrees(std::size_t count) {
+  subtreeHashes.resize(count);
+  byteRanges.resize(count);
+  std::string &bytes = nodeBytes;
+  // Children follow their parent, so they are hashed first going backwards
+  for (std::size_t i = count; i-- > 0;) {
+    std::uint32_t end = i + nodeExtents[i].size;
+    std::size_t begin = bytes.size();
+    append(bytes, strings[nodes[i].name]);
+    for (std::uint32_t e = nodes[i].firstEvent; e < endEvent(i); ++e) {
+      const auto &event = events[e];
+      bytes += static_cast<char>(event.kind);
+      switch (event.kind) {
+      case EventKind::Key:
+      case EventKind::String:
+        append(bytes, strings[event.index]);
+        break;
+      case EventKind::KeyArgument:
+        append(bytes, strings[event.index]);
+        append(bytes, strings[event.value]);
+        break;
+      case EventKind::UInt:
+      case EventKind::Int:
+      case EventKind::Bool:
+        append(bytes, event.value);
+        break;
+      case EventKind::Source:
+        append(bytes, llvm::StringRef{sources[event.index].data(),
+                                      sources[event.index].size()});
+        break;
+      case EventKind::Position:
+        append(bytes, ranges[event.index]);
+        break;
+      case EventKind::Id: {
+        // Nodes of the subtree by their place in it, others by their address
+        std::uint32_t target = find(event);
+        if (target > i && target < end) {
+          bytes += 'R';
+          append(bytes, target - static_cast<std::uint32_t>(i));
+        } else {
+          bytes += 'A';
+          append(bytes, event.value);
+          append(bytes, strings[event.index]);
+        }
+        break;
+      }
+      case EventKind::NullId:
+      case EventKind::BeginArray:
+      case EventKind::Element:
+      case EventKind::EndArray:
+        break;
+      }
+    }
+    for (std::uint32_t child = i + 1; child < end;
+         child += nodeExtents[child].size)
+      append(bytes, subtreeHashes[child]);
+    byteRanges[i] = {begin, bytes.size() - begin};
+    subtreeHashes[i] = llvm::xxh3_64bits(
+        llvm::arrayRefFromStringRef(llvm::StringRef{bytes}.substr(begin)));
+  }
+}
+
+// The bytes of a node hold its content and refer to the nodes of its subtree
+// by their place in it, so two subtrees of the same size are identical when
+// all their nodes have the same bytes
+bool DagWriter::identical(std::uint32_t a, std::uint32_t b,
+                          std::uint32_t size) const {
+  llvm::StringRef bytes = nodeBytes;
+  for (std::uint32_t j = 0; j < size; ++j) {
+    auto [aBegin, aSize] = byteRanges[a + j];
+    auto [bBegin, bSize] = byteRanges[b + j];
+    if (bytes.substr(aBegin, aSize) != bytes.substr(bBegin, bSize))
+      return false;
+  }
+  return true;
+}
+
+void DagWriter::findDuplicates(std::size_t count) {
+  sameAs.assign(nodes.size(), none);
+  replaced.assign(count, false);
+  llvm::DenseMap<std::uint64_t, std::uint32_t> first;
+  // Subtrees are skipped once replaced, so the first occurrences are all
+  // written
+  for (std::uint32_t i = 0; i < count;) {
+    std::uint32_t size = nodeExtents[i].size;
+    // A single node is as big as its reference
+    if (size < 2) {
+      ++i;
+      continue;
+    }
+    auto [it, inserted] = first.try_emplace(subtreeHashes[i], i);
+    std::uint32_t original = it->second;
+    // The hashes of different subtrees may collide
+    if (inserted || nodeExtents[original].size != size ||
+        nodes[original].name != nodes[i].name ||
+        !identical(original, i, size)) {
+      ++i;
+      continue;
+    }
+    replaced[i] = true;
+    for (std::uint32_t j = 0; j < size; ++j)
+      sameAs[i + j] = original + j;
+    i += size;
+  }
+}
+
+void DagWriter::writeEvent(const Event &event) {
+  switch (event.kind) {
+  case EventKind::Key:
+    out.key(std::string_view{strings[event.index]});
+    break;
+  case EventKind::KeyArgument:
+    out.key(std::string_view{strings[event.index]},
+            std::string_view{strings[event.value]});
+    break;
+  case EventKind::String:
+    out.value(std::string_view{strings[event.index]});
+    break;
+  case EventKind::UInt:
+    out.value(event.value);
+    break;
+  case EventKind::Int:
+    out.value(static_cast<int>(event.value));
+    break;
+  case EventKind::Bool:
+    out.value(event.value != 0);
+    break;
+  case EventKind::Source:
+    out.source(sources[event.index]);
+    break;
+  case EventKind::Position:
+    out.position(ranges[event.index]);
+    break;
+  case EventKind::Id: {
+    std::uint32_t target = find(event);
+    if (target == none) {
+      out.id(reinterpret_cast<const void *>(event.value),
+             std::string_view{strings[event.index]});
+      break;
+    }
+    const auto &node = nodes[resolve(target)];
+    out.id(node.address, std::string_view{strings[node.name]});
+    break;
+  }
+  case EventKind::NullId:
+    out.nullId();
+    break;
+  case EventKind::BeginArray:
+    out.beginArray();
+    break;
+  case EventKind::Element:
+    out.element();
+    break;
+  case EventKind::EndArray:
+    out.endArray();
+    break;
+  }
+}
+
+void DagWriter::writeNode(std::uint32_t i) {
+  const auto &node = nodes[i];
+  out.beginNode(node.address, std::string_view{strings[node.name]});
+  if (i >= replaced.size() || !replaced[i]) {
+    for (std::uint32_t e = node.firstEvent; e < endEvent(i); ++e)
+      writeEvent(events[e]);
+    out.endNode();
+    return;
+  }
+
+  const auto &original = nodes[sameAs[i]];
+  out.key("sameAs");
+  out.id(original.address, std::string_view{strings[original.name]});
+  // The source of this occurrence, with its key
+  for (std::uint32_t e = node.firstEvent + 1; e < endEvent(i); ++e) {
+    auto kind = events[e].kind;
+    if (kind == EventKind::Source || kind == EventKind::Position) {
+      writeEvent(events[e - 1]);
+      writeEvent(events[e]);
+      break;
+    }
+  }
+  out.endNode();
+}
+
+void DagWriter::endDocument() {
+  for (std::uint32_t i = 0; i < nodes.size(); ++i)
+    byAddress.try_emplace({nodes[i].address, nodes[i].name}, i);
+
+  // Nodes dumped after the parse tree, such as symbols, have no extent and
+  // are written as they are
+  std::size_t count = std::min(nodeExtents.size(), nodes.size());
+  hashSubtrees(count);
+  findDuplicates(count);
+
+  std::vector<std::uint32_t> writtenIndex(count, none);
+  for (std::uint32_t i = 0; i < count; ++i) {
+    if (sameAs[i] != none && !replaced[i])
+      continue;
+    const auto &extent = nodeExtents[i];
+    writtenIndex[i] = writtenExtents.size();
+    writtenExtents.push_back({extent.parent == NodeExtent::noParent
+                                  ? NodeExtent::noParent
+                                  : writtenIndex[extent.parent],
+                              extent.depth, 1});
+    writeNode(i);
+  }
+  for (std::size_t i = writtenExtents.size(); i-- > 0;) {
+    auto parent = writtenExtents[i].parent;
+    if (parent != NodeExtent::noParent)
+      writtenExtents[parent].size += writtenExtents[i].size;
+  }
+  if (forwardExtents && !nodeExtents.empty())
+    out.extents(writtenExtents);
+
+  for (std::uint32_t i = count; i < nodes.size(); ++i)
+    writeNode(i);
+  out.endDocument();
+}
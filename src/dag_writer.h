@@ -0,0 +1,149 @@
+#ifndef __DAG_WRITER_H__
+#define __DAG_WRITER_H__
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+
+#include "node_writer.h"
+
+// === DagWriter class ===
+//
+// Writes the parse tree as a DAG, with identical subtrees dumped once. The
+// nodes are recorded as they are dumped, and the extents then give the
+// subtree of each node, whose structural hash is computed bottom-up in
+// endDocument: the node name, keys, values and source text, the ids it refers
+// to, by their place in the subtree if they are in it, and the hashes of its
+// children. The nodes are then written to another writer in order, except
+// that a later subtree of at least two nodes with the hash of an earlier one
+// is replaced by its root, which only has a "sameAs" property referring to
+// the earlier root and the source of this occurrence. The hashed content of
+// the two subtrees is compared before, so a collision is not replaced.
+// References to the other nodes of a replaced subtree refer to their
+// counterparts in the earlier one.
+//
+// The whole dump is buffered until the document ends, so nothing reaches the
+// output while the tree is walked. Needs the extents, and is not split into
+// fragments.
+
+class DagWriter final : public NodeWriter {
+public:
+  // The extents of the written nodes are only passed on to `out` if
+  // `forwardExtents` is set
+  DagWriter(NodeWriter &out, bool forwardExtents)
+      : out(out), forwardExtents(forwardExtents) {}
+
+  void beginDocument(const Document &document) override {
+    out.beginDocument(document);
+  }
+  void endDocument() override;
+
+  void beginNode(const void *address, std::string_view name) override;
+  void endNode() override;
+
+  void key(std::string_view name) override;
+  void key(std::string_view name, std::string_view argument) override;
+
+  using NodeWriter::value;
+  void value(std::string_view v) override;
+  void value(std::uint64_t v) override;
+  void value(int v) override;
+  void value(bool v) override;
+
+  void source(std::string_view text) override;
+  void position(const SourceRange &range) override;
+
+  void id(const void *address, std::string_view name) override;
+  void nullId() override;
+
+  void beginArray() override;
+  void element() override;
+  void endArray() override;
+
+  void extents(llvm::ArrayRef<NodeExtent> extents) override {
+    nodeExtents = extents;
+  }
+
+  // Nothing is written before the document ends
+  std::uint64_t bytesWritten() const override { return out.bytesWritten(); }
+
+private:
+  enum class EventKind : std::uint8_t {
+    Key,         // index: name
+    KeyArgument, // index: name, value: argument
+    String,      // index: value
+    UInt,        // value
+    Int,         // value
+    Bool,        // value
+    Source,      // index: into sources
+    Position,    // index: into ranges
+    Id,          // index: name, value: address
+    NullId,
+    BeginArray,
+    Element,
+    EndArray,
+  };
+
+  struct Event {
+    EventKind kind;
+    std::uint32_t index;
+    std::uint64_t value;
+  };
+
+  struct Node {
+    const void *address;
+    std::uint32_t name;
+    std::uint32_t firstEvent;
+  };
+
+  std::uint32_t intern(std::string_view text);
+  void record(EventKind kind, std::uint32_t index = 0,
+              std::uint64_t value = 0) {
+    events.push_back({kind, index, value});
+  }
+
+  void hashSubtrees(std::size_t count);
+  void findDuplicates(std::size_t count);
+  bool identical(std::uint32_t a, std::uint32_t b, std::uint32_t size) const;
+  void writeNode(std::uint32_t node);
+  std::uint32_t endEvent(std::uint32_t node) const {
+    return node + 1 < nodes.size() ? nodes[node + 1].firstEvent
+                                   : events.size();
+  }
+  void writeEvent(const Event &event);
+  std::uint32_t find(const Event &id) const;
+  std::uint32_t resolve(std::uint32_t node) const;
+
+  NodeWriter &out;
+  bool forwardExtents;
+
+  llvm::StringMap<std::uint32_t> stringIndex;
+  std::vector<llvm::StringRef> strings;
+  std::vector<std::string_view> sources;
+  std::vector<SourceRange> ranges;
+  std::vector<Event> events;
+  std::vector<Node> nodes;
+  llvm::ArrayRef<NodeExtent> nodeExtents;
+
+  // Index of the node dumped at each address, with each name
+  llvm::DenseMap<std::pair<const void *, std::uint32_t>, std::uint32_t>
+      byAddress;
+  std::vector<std::uint64_t> subtreeHashes;
+  // Hashed content of the nodes, and the offset and size of each one in it
+  std::string nodeBytes;
+  std::vector<std::pair<std::size_t, std::size_t>> byteRanges;
+  // For the root of a replaced subtree, the root it is the same as; for the
+  // other nodes of the subtree, their counterpart. none otherwise.
+  std::vector<std::uint32_t> sameAs;
+  std::vector<bool> replaced; // Roots of the replaced subtrees
+  std::vector<NodeExtent> writtenExtents;
+};
+
+#endif // __DAG_WRITER_H__
@@ -0,0 +1,90 @@
+#include <memory>
+#include <vector>
+
+#include <llvm/Support/TargetSelect.h>
+
+#include "clang/Basic/DiagnosticIDs.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "flang/Frontend/CompilerInstance.h"
+#include "flang/Frontend/CompilerInvocation.h"
+#include "flang/Frontend/TextDiagnosticBuffer.h"
+
+#include "driver.h"
+#include "line_map.h"
+
+void initializeFrontend() {
+  llvm::InitializeAllTargetInfos();
+  llvm::InitializeAllTargets();
+  llvm::InitializeAllTargetMCs();
+}
+
+// Instance that compiles `input` with `arguments`, or nullptr if they are
+// invalid
+static std::unique_ptr<Fortran::frontend::CompilerInstance>
+createInstance(llvm::StringRef input, llvm::ArrayRef<std::string> arguments) {
+  auto flang = std::make_unique<Fortran::frontend::CompilerInstance>();
+  flang->createDiagnostics();
+  if (!flang->hasDiagnostics())
+    return nullptr;
+
+  std::string inputPath = input.str();
+  std::vector<const char *> argv;
+  for (const auto &argument : arguments)
+    argv.push_back(argument.c_str());
+  argv.push_back(inputPath.c_str());
+
+  // Diagnostics from parsing the arguments are buffered, and reported through
+  // the diagnostics of the instance
+  auto *diagsBuffer = new Fortran::frontend::TextDiagnosticBuffer;
+  llvm::IntrusiveRefCntPtr<clang::DiagnosticIDs> diagID(
+      new clang::DiagnosticIDs());
+  clang::DiagnosticOptions diagOpts;
+  clang::DiagnosticsEngine diags(diagID, diagOpts, diagsBuffer);
+  bool success = Fortran::frontend::CompilerInvocation::createFromArgs(
+      flang->getInvocation(), argv, diags, "flang-dumper");
+  diagsBuffer->flushDiagnostics(flang->getDiagnostics());
+  if (!success)
+    return nullptr;
+  return flang;
+}
+
+bool runFrontendAction(Fortran::frontend::FrontendAction &action,
+                       llvm::StringRef input,
+                       llvm::ArrayRef<std::string> arguments) {
+  auto flang = createInstance(input, arguments);
+  return flang && flang->executeAction(action);
+}
+
+std::unique_ptr<ParsedFile>
+ParsedFile::parse(Fortran::frontend::FrontendAction &action,
+                  llvm::StringRef input,
+                  llvm::ArrayRef<std::string> arguments) {
+  auto flang = createInstance(input, arguments);
+  if (!flang || !flang->executeAction(action))
+    return nullptr;
+  return std::unique_ptr<ParsedFile>(new ParsedFile(std::move(flang)));
+}
+
+bool ParsedFile::run(Fortran::frontend::FrontendAction &action) {
+  // What CompilerInstance::executeAction does for each input, without
+  // beginSourceFile, which would parse the input again
+  const auto &inputs = instance->getFrontendOpts().inputs;
+  if (inputs.empty())
+    return false;
+  // The client counts the errors of every action run on the instance
+  auto *diagnostics = instance->getDiagnostics().getClient();
+  unsigned errors = diagnostics->getNumErrors();
+  action.setInstance(instance.get());
+  action.setCurrentInput(inputs.front());
+  if (llvm::Error error = action.execute()) {
+    llvm::consumeError(std::move(error));
+    action.endSourceFile();
+    return false;
+  }
+  action.endSourceFile();
+  return diagnostics->getNumErrors() == errors;
+}
+
+std::vector<std::string> ParsedFile::sourceFiles() const {
+  return LineMap(instance->getParsing()).files();
+}
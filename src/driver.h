@@ -0,0 +1,56 @@
+#ifndef __DRIVER_H__
+#define __DRIVER_H__
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/StringRef.h>
+
+#include "flang/Frontend/CompilerInstance.h"
+#include "flang/Frontend/FrontendAction.h"
+
+// Registers the LLVM targets needed by the frontend. Call once, before the
+// first action.
+void initializeFrontend();
+
+// Runs `action` on `input` in a new compiler instance, as
+// `flang -fc1 <arguments> <input>` would, and returns whether it succeeded.
+// Instances are independent, so actions can run on several threads at once.
+bool runFrontendAction(Fortran::frontend::FrontendAction &action,
+                       llvm::StringRef input,
+                       llvm::ArrayRef<std::string> arguments);
+
+// === ParsedFile class ===
+//
+// Compiler instance kept alive after its first action, so that further
+// actions run on the parse tree it holds instead of parsing the input again.
+// Only actions that read the parse tree can run again: the instance does not
+// prescan, parse or run semantics a second time.
+
+class ParsedFile {
+public:
+  // Runs `action` on `input` like runFrontendAction, and returns the
+  // instance if it succeeded
+  static std::unique_ptr<ParsedFile>
+  parse(Fortran::frontend::FrontendAction &action, llvm::StringRef input,
+        llvm::ArrayRef<std::string> arguments);
+
+  // Runs `action` on the parse tree. Not thread-safe: runs on the same file
+  // must not overlap.
+  bool run(Fortran::frontend::FrontendAction &action);
+
+  // Paths of the original files the parse tree comes from: the input and the
+  // files it includes, as they were opened
+  std::vector<std::string> sourceFiles() const;
+
+private:
+  explicit ParsedFile(
+      std::unique_ptr<Fortran::frontend::CompilerInstance> instance)
+      : instance(std::move(instance)) {}
+
+  std::unique_ptr<Fortran::frontend::CompilerInstance> instance;
+};
+
+#endif // __DRIVER_H__
@@ -0,0 +1,116 @@
+#ifndef __DUMP_AST_H__
+#define __DUMP_AST_H__
+
+#include <optional>
+#include <string>
+
+#include <llvm/ADT/STLFunctionalExtras.h>
+#include <llvm/ADT/Twine.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "flang/Frontend/FrontendActions.h"
+
+#include "enum_schema.h"
+#include "node_writer.h"
+#include "options.h"
+#include "selection.h"
+#include "shard_writer.h"
+#include "structural_hash.h"
+
+// === DumpAST action ===
+//
+// Dumps the parse tree of the input as JSON. The plugin registry uses the
+// default constructor, which writes to stdout with the options given on the
+// command line; drivers can pass their own stream and options instead.
+
+class DumpAST : public Fortran::frontend::PluginParseTreeAction {
+public:
+  DumpAST();
+  DumpAST(llvm::raw_ostream &os, const DumpOptions &options);
+
+protected:
+  // Dumps the selected part of the parse tree, and writes the profile and the
+  // hash index if they are requested. The structural hashes of the dump are
+  // also copied to `index` if it is given. `ids` is the id mode of `out`,
+  // which the hash index records.
+  void dumpParseTree(NodeWriter &out, IdMode ids, HashIndex *index = nullptr);
+  void executeAction() override;
+
+  // Writes the difference between the parse tree and the one of options.diff
+  // instead of the dump, see writeTreeDiff
+  void dumpTreeDiff();
+
+  // Writes the JSON dump in the shards of options.shards, and their index,
+  // see ShardWriter
+  void dumpShards();
+
+  // Runs `write` on the -dump-ast-output file if one is given, or on the
+  // stream of the constructor
+  void writeOutput(llvm::function_ref<void(llvm::raw_ostream &)> write);
+
+  // Runs `dump` on the output, unless the cache of the options already holds
+  // its result. `format` tells apart the dumps of the different actions.
+  void dumpThroughCache(llvm::StringRef format,
+                        llvm::function_ref<void(llvm::raw_ostream &)> dump);
+
+  // Reports an error through the diagnostics of the compiler instance, so
+  // that the action fails
+  void reportError(const llvm::Twine &message);
+
+  // Called once the parse tree is dumped, before the document ends
+  virtual void dumpAfterParseTree(NodeWriter &) {}
+
+  llvm::raw_ostream &os;
+  DumpOptions options;
+
+private:
+  // Parsed once from options.select, or the error that makes it invalid
+  std::optional<Selector> selector;
+  std::string selectorError;
+  // Whether the dump is hashed or written as a DAG, which need the extents
+  bool hashing = false;
+  bool dag = false;
+  // Told where the program units start when dumping in shards
+  ShardWriter *sharding = nullptr;
+
+  void walkParseTree(NodeWriter &out);
+  template <typename Visitor> void walk(Visitor &visitor, NodeWriter &out);
+};
+
+// Dumps the parse tree in the binary format
+class DumpASTBinary : public DumpAST {
+public:
+  using DumpAST::DumpAST;
+
+protected:
+  void executeAction() override;
+};
+
+// Runs semantics, then dumps the parse tree as JSON followed by the symbol
+// table. Names refer to their symbol and expressions carry their type.
+class DumpASTSemantics : public DumpAST {
+public:
+  using DumpAST::DumpAST;
+
+protected:
+  void executeAction() override;
+  void dumpAfterParseTree(NodeWriter &out) override;
+};
+
+// Writes the enum schema that dumps made with -dump-ast-enums=reference refer
+// to, whatever the input
+class DumpASTSchema : public DumpAST {
+public:
+  using DumpAST::DumpAST;
+
+protected:
+  void executeAction() override;
+};
+
+// Schema of the enums of the dumps
+const EnumSchema &enumSchema();
+
+// Writes enumSchema() as {"schema": "<hash>", "enums": {...}}
+void dumpEnumSchema(llvm::raw_ostream &os);
+
+#endif // __DUMP_AST_H__
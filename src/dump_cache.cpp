@@ -0,0 +1,233 @@
+#include <algorithm>
+#include <vector>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/SHA256.h>
+
+#include "flang/Support/Version.h"
+
+#include "compressed_stream.h"
+#include "dump_cache.h"
+
+// Bump whenever the dumps change, so that the entries written by an older
+// dumper are not served
+static constexpr std::uint32_t cacheVersion = 2;
+
+// Extension of the entries being written
+static constexpr llvm::StringLiteral temporaryExtension = ".tmp";
+
+DumpCache::DumpCache(std::string directory, std::uint64_t capacity)
+    : directory(std::move(directory)), capacity(capacity) {
+  llvm::sys::fs::create_directories(this->directory);
+}
+
+DumpCache::~DumpCache() = default;
+
+DumpCache *DumpCache::get(const DumpOptions &options) {
+  if (options.cache.empty())
+    return nullptr;
+
+  static std::mutex registryMutex;
+  static llvm::StringMap<std::unique_ptr<DumpCache>> registry;
+  std::lock_guard<std::mutex> lock(registryMutex);
+  auto &cache = registry[options.cache];
+  if (!cache)
+    cache = std::make_unique<DumpCache>(options.cache, options.cacheSize);
+  return cache.get();
+}
+
+std::string DumpCache::key(std::string_view source, std::string_view file,
+                           std::string_view provenance,
+                           std::string_view format,
+                           const DumpOptions &options) {
+  llvm::SHA256 hash;
+  // Every field is prefixed with its size, so that fields cannot run into
+  // each other
+  auto add = [&hash](std::string_view field) {
+    std::uint64_t size = field.size();
+    hash.update(llvm::ArrayRef<std::uint8_t>(
+        reinterpret_cast<const std::uint8_t *>(&size), sizeof(size)));
+    hash.update(llvm::StringRef(field.data(), field.size()));
+  };
+
+  add(std::to_string(cacheVersion));
+  add(Fortran::common::getFlangFullVersion());
+  add(format);
+  add(file);
+  add(source);
+  add(provenance);
+
+  // Options that change the output
+  add(std::to_string(static_cast<int>(options.ids)));
+  add(std::to_string(static_cast<int>(options.source)));
+  add(std::to_string(static_cast<int>(options.layout)));
+  add(std::to_string(static_cast<int>(options.enums)));
+  add(std::to_string(static_cast<int>(options.encoding)));
+  add(std::to_string(options.extents));
+  add(std::to_string(options.dag));
+  add(options.select);
+  add(std::to_string(static_cast<int>(
+      CompressedStream::available(options.compression))));
+  add(std::to_string(options.compressionLevel));
+  // Multithreaded zstd splits the input into jobs, which changes the output
+  add(std::to_string(options.compressionThreads > 0));
+
+  return llvm::toHex(hash.final(), /*LowerCase=*/true);
+}
+
+std::string DumpCache::path(llvm::StringRef key) const {
+  llvm::SmallString<256> result(directory);
+  llvm::sys::path::append(result, key);
+  return result.str().str();
+}
+
+bool DumpCache::fetch(const std::string &key, llvm::raw_ostream &os) {
+  std::string entryPath = path(key);
+  int fd;
+  if (llvm::sys::fs::openFileForRead(entryPath, fd)) {
+    std::lock_guard<std::mutex> lock(mutex);
+    ++counters.misses;
+    return false;
+  }
+
+  auto buffer = llvm::MemoryBuffer::getOpenFile(fd, entryPath, -1,
+                                                /*RequiresNullTerminator=*/
+                                                false);
+  // Mark the entry as used, for this process and for the others
+  auto now = std::chrono::system_clock::now();
+  llvm::sys::fs::setLastAccessAndModificationTime(fd, now);
+  llvm::sys::fs::closeFile(fd);
+
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!buffer) {
+    ++counters.misses;
+    return false;
+  }
+  ++counters.hits;
+  auto entry = index.find(key);
+  if (entry != index.end())
+    entry->second.lastUse = now;
+
+  os << (*buffer)->getBuffer();
+  return true;
+}
+
+std::unique_ptr<DumpCache::Writer> DumpCache::store(const std::string &key,
+                                                    llvm::raw_ostream &os) {
+  {
+    // The index is loaded before the entry is added, so the entry is not
+    // counted twice
+    std::lock_guard<std::mutex> lock(mutex);
+    loadIndex();
+  }
+
+  int fd;
+  llvm::SmallString<256> temporary;
+  if (llvm::sys::fs::createUniqueFile(path(key) + "-%%%%%%" +
+                                          temporaryExtension,
+                                      fd, temporary))
+    return nullptr;
+  return std::make_unique<Writer>(*this, key, temporary.str().str(), fd, os);
+}
+
+DumpCache::Stats DumpCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return counters;
+}
+
+void DumpCache::added(llvm::StringRef key, std::uint64_t size) {
+  std::lock_guard<std::mutex> lock(mutex);
+  ++counters.stores;
+
+  auto [entry, inserted] =
+      index.try_emplace(key, Entry{size, std::chrono::system_clock::now()});
+  if (!inserted) {
+    // Another process stored the same dump
+    totalSize -= entry->second.size;
+    entry->second = {size, std::chrono::system_clock::now()};
+  }
+  totalSize += size;
+
+  if (totalSize > capacity)
+    evict();
+}
+
+void DumpCache::loadIndex() {
+  if (indexLoaded)
+    return;
+  indexLoaded = true;
+
+  std::error_code ec;
+  for (llvm::sys::fs::directory_iterator it(directory, ec), end;
+       it != end && !ec; it.increment(ec)) {
+    llvm::StringRef name = llvm::sys::path::filename(it->path());
+    if (name.ends_with(temporaryExtension))
+      continue;
+    auto status = it->status();
+    if (!status || status->type() != llvm::sys::fs::file_type::regular_file)
+      continue;
+    index[name] = {status->getSize(), status->getLastModificationTime()};
+    totalSize += status->getSize();
+  }
+}
+
+void DumpCache::evict() {
+  // Evict down to 90% of the capacity, so that the next stores do not evict
+  // again right away
+  std::uint64_t target = capacity - capacity / 10;
+
+  std::vector<llvm::StringMapEntry<Entry> *> entries;
+  entries.reserve(index.size());
+  for (auto &entry : index)
+    entries.push_back(&entry);
+  std::sort(entries.begin(), entries.end(), [](auto *a, auto *b) {
+    return a->second.lastUse < b->second.lastUse;
+  });
+
+  for (auto *entry : entries) {
+    if (totalSize <= target)
+      break;
+    llvm::sys::fs::remove(path(entry->first()));
+    totalSize -= entry->second.size;
+    ++counters.evictions;
+    index.erase(entry->first());
+  }
+}
+
+DumpCache::Writer::Writer(DumpCache &cache, std::string key,
+                          std::string temporary, int fd, llvm::raw_ostream &os)
+    : cache(cache), key(std::move(key)), temporary(std::move(temporary)),
+      file(fd, /*shouldClose=*/true), os(os) {
+  SetUnbuffered();
+}
+
+DumpCache::Writer::~Writer() {
+  if (!committed) {
+    file.close();
+    llvm::sys::fs::remove(temporary);
+  }
+}
+
+void DumpCache::Writer::write_impl(const char *ptr, std::size_t size) {
+  os.write(ptr, size);
+  file.write(ptr, size);
+  written += size;
+}
+
+void DumpCache::Writer::commit() {
+  flush();
+  file.close();
+  committed = true;
+
+  if (file.has_error() ||
+      llvm::sys::fs::rename(temporary, cache.path(key))) {
+    file.clear_error();
+    llvm::sys::fs::remove(temporary);
+    return;
+  }
+  cache.added(key, written);
+}
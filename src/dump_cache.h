@@ -0,0 +1,116 @@
+#ifndef __DUMP_CACHE_H__
+#define __DUMP_CACHE_H__
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Chrono.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "options.h"
+
+// === DumpCache class ===
+//
+// Directory of previous dumps, addressed by a hash of everything the dump
+// depends on: the cooked source, the file name, the output format, the options
+// that change the output, and the versions of flang and of the dumper. Dumps
+// with source positions or line terms also depend on where the cooked source
+// comes from in the original files, which is hashed too. A hit is copied to
+// the output without walking the parse tree.
+//
+// Entries are written to a temporary file and renamed into place, so several
+// processes can share a directory. Once the entries exceed the capacity, the
+// least recently used ones are removed; the modification time of an entry is
+// its last use, so the order is shared between processes too.
+
+class DumpCache {
+public:
+  struct Stats {
+    std::uint64_t hits = 0;
+    std::uint64_t misses = 0;
+    std::uint64_t stores = 0;
+    std::uint64_t evictions = 0;
+  };
+
+  class Writer;
+
+  DumpCache(std::string directory, std::uint64_t capacity);
+  DumpCache(const DumpCache &) = delete;
+  DumpCache &operator=(const DumpCache &) = delete;
+  ~DumpCache();
+
+  // The cache of options.cache, shared by every action of the process, or
+  // nullptr if there is none
+  static DumpCache *get(const DumpOptions &options);
+
+  // `provenance` is LineMap::provenance() if the dump maps the source back to
+  // the original files, and empty otherwise
+  static std::string key(std::string_view source, std::string_view file,
+                         std::string_view provenance, std::string_view format,
+                         const DumpOptions &options);
+
+  // Copies the entry of `key` to `os`. Returns false on a miss.
+  bool fetch(const std::string &key, llvm::raw_ostream &os);
+
+  // Stream that writes to `os` and to a new entry for `key`. The entry is only
+  // added once the writer is committed. Returns nullptr if the entry cannot be
+  // created.
+  std::unique_ptr<Writer> store(const std::string &key, llvm::raw_ostream &os);
+
+  Stats stats() const;
+
+private:
+  struct Entry {
+    std::uint64_t size;
+    llvm::sys::TimePoint<> lastUse;
+  };
+
+  std::string path(llvm::StringRef key) const;
+  void added(llvm::StringRef key, std::uint64_t size);
+  void loadIndex();
+  void evict();
+
+  std::string directory;
+  std::uint64_t capacity;
+
+  mutable std::mutex mutex;
+  Stats counters;
+  // Entries and their total size, loaded on the first store
+  llvm::StringMap<Entry> index;
+  std::uint64_t totalSize = 0;
+  bool indexLoaded = false;
+};
+
+// === DumpCache::Writer class ===
+//
+// Tee stream of DumpCache::store. It is unbuffered, so the output is not
+// copied once more on its way to the writer's own stream.
+
+class DumpCache::Writer final : public llvm::raw_ostream {
+public:
+  Writer(DumpCache &cache, std::string key, std::string temporary, int fd,
+         llvm::raw_ostream &os);
+  ~Writer() override;
+
+  // Adds the entry to the cache
+  void commit();
+
+private:
+  void write_impl(const char *ptr, std::size_t size) override;
+  std::uint64_t current_pos() const override { return written; }
+
+  DumpCache &cache;
+  std::string key;
+  std::string temporary;
+  llvm::raw_fd_ostream file;
+  llvm::raw_ostream &os;
+  std::uint64_t written = 0;
+  bool committed = false;
+};
+
+#endif // __DUMP_CACHE_H__
@@ -0,0 +1,45 @@
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/SHA256.h>
+
+#include "enum_schema.h"
+#include "json_escape.h"
+
+static void appendString(std::string &out, std::string_view s) {
+  out += '"';
+  const char *p = s.data();
+  const char *end = p + s.size();
+  char sequence[6];
+  while (true) {
+    const char *escape = json_escape::find(p, end);
+    out.append(p, escape - p);
+    if (escape == end)
+      break;
+    out += json_escape::sequence(*escape, sequence);
+    p = escape + 1;
+  }
+  out += '"';
+}
+
+EnumSchema::EnumSchema(std::vector<EnumEntry> enums)
+    : entries(std::move(enums)) {
+  object += '{';
+  for (std::size_t i = 0; i < entries.size(); ++i) {
+    if (i > 0)
+      object += ", ";
+    appendString(object, entries[i].name);
+    object += ": [";
+    const auto &values = entries[i].values;
+    for (std::size_t j = 0; j < values.size(); ++j) {
+      if (j > 0)
+        object += ", ";
+      appendString(object, values[j]);
+    }
+    object += ']';
+  }
+  object += '}';
+
+  auto hash = llvm::SHA256::hash(llvm::ArrayRef<std::uint8_t>(
+      reinterpret_cast<const std::uint8_t *>(object.data()), object.size()));
+  digest = llvm::toHex(llvm::ArrayRef<std::uint8_t>(hash).take_front(8),
+                       /*LowerCase=*/true);
+}
@@ -0,0 +1,42 @@
+#ifndef __ENUM_SCHEMA_H__
+#define __ENUM_SCHEMA_H__
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <llvm/ADT/ArrayRef.h>
+
+// Names of the values of a dumped enum
+struct EnumEntry {
+  std::string_view name;
+  std::vector<std::string_view> values;
+};
+
+// === EnumSchema class ===
+//
+// The enums a dump refers to, serialized once as a JSON object
+//   {"<Enum>": ["<value>", ...], ...}
+// and identified by a hash of that object. The enums only change with the
+// plugin, so the schema is built once per process, and dumps can refer to it
+// by its hash instead of repeating it (see EnumMode).
+
+class EnumSchema {
+public:
+  explicit EnumSchema(std::vector<EnumEntry> enums);
+
+  llvm::ArrayRef<EnumEntry> enums() const { return entries; }
+
+  // JSON object of the enums, on a single line
+  std::string_view json() const { return object; }
+
+  // First 16 hex digits of the SHA-256 of json()
+  std::string_view hash() const { return digest; }
+
+private:
+  std::vector<EnumEntry> entries;
+  std::string object;
+  std::string digest;
+};
+
+#endif // __ENUM_SCHEMA_H__
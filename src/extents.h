@@ -0,0 +1,68 @@
+#ifndef __EXTENTS_H__
+#define __EXTENTS_H__
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include <llvm/ADT/ArrayRef.h>
+
+#include "node_writer.h"
+
+// === ExtentRecorder class ===
+//
+// Builds the NodeExtent of every dumped node. Nodes are dumped in pre-order,
+// so a node is entered when it is dumped, and left once its subtree has been
+// walked, which gives the size of the subtree.
+
+class ExtentRecorder {
+public:
+  void enter(const void *node, std::string_view name) {
+    std::uint32_t index = extents.size();
+    extents.push_back({open.empty() ? NodeExtent::noParent : open.back().index,
+                       static_cast<std::uint32_t>(open.size()), 1});
+    open.push_back({node, name.data(), index});
+  }
+
+  // Called for every node, dumped or not. A node shares its address with its
+  // first member, so the name tells them apart; names are NodeTraits names,
+  // compared by address.
+  void leave(const void *node, std::string_view name) {
+    if (open.empty() || open.back().node != node ||
+        open.back().name != name.data())
+      return;
+    auto index = open.back().index;
+    open.pop_back();
+    extents[index].size = extents.size() - index;
+  }
+
+  // Appends the extents recorded by `part` for subtrees of the open node, in
+  // the order of the dump
+  void splice(const ExtentRecorder &part) {
+    std::uint32_t offset = extents.size();
+    std::uint32_t parent =
+        open.empty() ? NodeExtent::noParent : open.back().index;
+    std::uint32_t depth = open.size();
+    for (auto extent : part.extents) {
+      extent.parent = extent.parent == NodeExtent::noParent
+                          ? parent
+                          : extent.parent + offset;
+      extent.depth += depth;
+      extents.push_back(extent);
+    }
+  }
+
+  llvm::ArrayRef<NodeExtent> get() const { return extents; }
+
+private:
+  struct OpenNode {
+    const void *node;
+    const char *name;
+    std::uint32_t index;
+  };
+
+  std::vector<NodeExtent> extents;
+  std::vector<OpenNode> open; // Dumped nodes whose subtree is being walked
+};
+
+#endif // __EXTENTS_H__
@@ -0,0 +1,123 @@
+#include "json_escape.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define JSON_ESCAPE_X86 1
+#include <atomic>
+#include <immintrin.h>
+#endif
+
+namespace json_escape {
+
+const char *findScalar(const char *begin, const char *end) {
+  for (const char *p = begin; p != end; ++p)
+    if (needsEscape(*p))
+      return p;
+  return end;
+}
+
+#ifdef JSON_ESCAPE_X86
+
+// A byte needs escaping if it is '"', '\\', or at most 0x1f as an unsigned
+// value, which is tested as max(c, 0x1f) == 0x1f
+
+static const char *findSSE2(const char *begin, const char *end) {
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i control = _mm_set1_epi8(0x1f);
+
+  const char *p = begin;
+  for (; end - p >= 16; p += 16) {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    __m128i mask = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                     _mm_cmpeq_epi8(chunk, backslash)),
+        _mm_cmpeq_epi8(_mm_max_epu8(chunk, control), control));
+    if (int bits = _mm_movemask_epi8(mask))
+      return p + __builtin_ctz(bits);
+  }
+  return findScalar(p, end);
+}
+
+__attribute__((target("avx2"))) static const char *findAVX2(const char *begin,
+                                                            const char *end) {
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i backslash = _mm256_set1_epi8('\\');
+  const __m256i control = _mm256_set1_epi8(0x1f);
+
+  const char *p = begin;
+  for (; end - p >= 32; p += 32) {
+    __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    __m256i mask = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, quote),
+                        _mm256_cmpeq_epi8(chunk, backslash)),
+        _mm256_cmpeq_epi8(_mm256_max_epu8(chunk, control), control));
+    if (unsigned bits = _mm256_movemask_epi8(mask))
+      return p + __builtin_ctz(bits);
+  }
+  return findSSE2(p, end);
+}
+
+using FindFunc = const char *(*)(const char *, const char *);
+
+static FindFunc selectFind() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2") ? findAVX2 : findSSE2;
+}
+
+static const char *findFirst(const char *begin, const char *end);
+
+// Starts as findFirst, which selects the implementation on the first call.
+// It is constant initialized, so escapes from static initializers run before
+// this one, such as those of the enum registrars, find it set.
+static std::atomic<FindFunc> findImpl{findFirst};
+
+static const char *findFirst(const char *begin, const char *end) {
+  FindFunc selected = selectFind();
+  findImpl.store(selected, std::memory_order_relaxed);
+  return selected(begin, end);
+}
+
+const char *find(const char *begin, const char *end) {
+  return findImpl.load(std::memory_order_relaxed)(begin, end);
+}
+
+#else
+
+const char *find(const char *begin, const char *end) {
+  return findScalar(begin, end);
+}
+
+#endif // JSON_ESCAPE_X86
+
+std::string_view sequence(char c, char *buffer) {
+  switch (c) {
+  case '"':
+    return "\\\"";
+  case '\\':
+    return "\\\\";
+  case '\b':
+    return "\\b";
+  case '\f':
+    return "\\f";
+  case '\n':
+    return "\\n";
+  case '\r':
+    return "\\r";
+  case '\t':
+    return "\\t";
+  default:
+    break;
+  }
+
+  static constexpr char hexDigits[] = "0123456789abcdef";
+  auto byte = static_cast<unsigned char>(c);
+  buffer[0] = '\\';
+  buffer[1] = 'u';
+  buffer[2] = '0';
+  buffer[3] = '0';
+  buffer[4] = hexDigits[byte >> 4];
+  buffer[5] = hexDigits[byte & 0xf];
+  return std::string_view(buffer, 6);
+}
+
+} // namespace json_escape
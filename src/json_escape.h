@@ -0,0 +1,34 @@
+#ifndef __JSON_ESCAPE_H__
+#define __JSON_ESCAPE_H__
+
+#include <cstddef>
+#include <string_view>
+
+// === JSON string escaping ===
+//
+// Characters that RFC 8259 requires to be escaped in a string are the
+// quotation mark, the reverse solidus and the control characters below 0x20.
+// Source text rarely contains them, so the writer looks for the next one and
+// copies everything before it in one block.
+
+namespace json_escape {
+
+// Returns the first character of [begin, end) that must be escaped, or end.
+// Scans 32 bytes at a time with AVX2 or 16 with SSE2 when the CPU supports
+// them.
+const char *find(const char *begin, const char *end);
+
+// Portable implementation of find, one byte at a time
+const char *findScalar(const char *begin, const char *end);
+
+inline bool needsEscape(char c) {
+  return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+}
+
+// Escape sequence of a character for which needsEscape is true. `buffer` holds
+// at least 6 characters; the result may point into it.
+std::string_view sequence(char c, char *buffer);
+
+} // namespace json_escape
+
+#endif // __JSON_ESCAPE_H__
@@ -0,0 +1,336 @@
+#include <algorithm>
+
+#include "json_escape.h"
+#include "json_writer.h"
+
+const JsonWriter::Separators JsonWriter::documentSeparators = {
+    ",\n", "{\n\"id\": ", "\n}", ",\n\"", "[\n", ",\n"};
+const JsonWriter::Separators JsonWriter::lineSeparators = {
+    "", "{\"id\": ", "}\n", ", \"", "[", ", "};
+const JsonWriter::Separators JsonWriter::positionalDocumentSeparators = {
+    ",\n", "[", "]", ",", "[", ","};
+const JsonWriter::Separators JsonWriter::positionalLineSeparators = {
+    "", "[", "]\n", ",", "[", ","};
+
+const JsonWriter::Separators &
+JsonWriter::separatorsFor(JsonLayout layout, PropertyEncoding encoding) {
+  if (encoding == PropertyEncoding::Positional)
+    return layout == JsonLayout::Lines ? positionalLineSeparators
+                                       : positionalDocumentSeparators;
+  return layout == JsonLayout::Lines ? lineSeparators : documentSeparators;
+}
+
+JsonWriter::JsonWriter(llvm::raw_ostream &os, const DumpOptions &options,
+                       std::size_t capacity)
+    : os(os), idMode(options.ids), sourceMode(options.source),
+      layout(options.layout), enumMode(options.enums),
+      encoding(options.encoding), separators(separatorsFor(layout, encoding)),
+      buffer(new char[capacity]), capacity(capacity) {}
+
+JsonWriter::JsonWriter(std::unique_ptr<Fragment> fragment,
+                       const JsonWriter &parent)
+    : os(fragment->os), idMode(parent.idMode), sourceMode(parent.sourceMode),
+      layout(parent.layout), enumMode(parent.enumMode),
+      encoding(parent.encoding), separators(parent.separators),
+      schema(parent.schema), document(parent.document),
+      locator(parent.locator), buffer(new char[parent.capacity]),
+      capacity(parent.capacity), firstNode(false),
+      fragment(std::move(fragment)) {}
+
+JsonWriter::~JsonWriter() { flush(); }
+
+void JsonWriter::flush() {
+  if (size > 0) {
+    os.write(buffer.get(), size);
+    flushed += size;
+    size = 0;
+  }
+}
+
+void JsonWriter::makeRoom(std::size_t bytes) {
+  if (nodeStart == noNode) {
+    flush();
+    return;
+  }
+
+  // What precedes the node can be written out
+  if (nodeStart > 0) {
+    os.write(buffer.get(), nodeStart);
+    flushed += nodeStart;
+    std::memmove(buffer.get(), buffer.get() + nodeStart, size - nodeStart);
+    size -= nodeStart;
+    nodeStart = 0;
+    if (bytes <= capacity - size)
+      return;
+  }
+
+  std::size_t grown = std::max(2 * capacity, size + bytes);
+  std::unique_ptr<char[]> larger(new char[grown]);
+  std::memcpy(larger.get(), buffer.get(), size);
+  buffer = std::move(larger);
+  capacity = grown;
+}
+
+void JsonWriter::writeUInt(std::uint64_t v) {
+  char digits[20];
+  char *end = digits + sizeof(digits);
+  char *p = end;
+  do {
+    *--p = static_cast<char>('0' + v % 10);
+    v /= 10;
+  } while (v != 0);
+  write(std::string_view(p, end - p));
+}
+
+void JsonWriter::writeInt(std::int64_t v) {
+  if (v < 0) {
+    write('-');
+    writeUInt(0 - static_cast<std::uint64_t>(v));
+  } else {
+    writeUInt(static_cast<std::uint64_t>(v));
+  }
+}
+
+void JsonWriter::writeHex(std::uintptr_t v) {
+  static constexpr char hexDigits[] = "0123456789abcdef";
+  char digits[2 * sizeof(std::uintptr_t)];
+  char *end = digits + sizeof(digits);
+  char *p = end;
+  do {
+    *--p = hexDigits[v & 0xf];
+    v >>= 4;
+  } while (v != 0);
+  write(std::string_view(p, end - p));
+}
+
+void JsonWriter::writeEscaped(std::string_view s) {
+  const char *p = s.data();
+  const char *end = p + s.size();
+  char sequence[6];
+  while (true) {
+    const char *escape = json_escape::find(p, end);
+    write(std::string_view(p, escape - p));
+    if (escape == end)
+      return;
+    write(json_escape::sequence(*escape, sequence));
+    p = escape + 1;
+  }
+}
+
+void JsonWriter::writeId(const void *address, std::string_view name) {
+  write("0x");
+  writeHex(reinterpret_cast<std::uintptr_t>(address));
+  write('-');
+  write(name);
+}
+
+void JsonWriter::writeFiles(llvm::ArrayRef<std::string> files) {
+  write('[');
+  for (std::size_t i = 0; i < files.size(); ++i) {
+    if (i > 0)
+      write(", ");
+    value(files[i]);
+  }
+  write(']');
+}
+
+void JsonWriter::writeSchema(const EnumSchema &schema) {
+  write("\"schema\": \"");
+  write(schema.hash());
+  write('"');
+  if (enumMode == EnumMode::Inline) {
+    write(layout == JsonLayout::Lines ? ", " : ",\n");
+    write("\"enums\": ");
+    write(schema.json());
+  }
+}
+
+void JsonWriter::position(const SourceRange &range) {
+  if (range.file == SourceRange::noFile) {
+    write("null");
+    return;
+  }
+  write('[');
+  writeUInt(range.file);
+  write(", ");
+  writeUInt(range.line);
+  write(", ");
+  writeUInt(range.column);
+  write(", ");
+  writeUInt(range.endLine);
+  write(", ");
+  writeUInt(range.endColumn);
+  write(']');
+}
+
+void JsonWriter::beginNode(const void *address, std::string_view name) {
+  if (!firstNode)
+    write(separators.node);
+  firstNode = false;
+  if (encoding == PropertyEncoding::Positional) {
+    // The layout is written in front of the node once it ends
+    layouts.begin(name);
+    nodeStart = size;
+    id(address, name);
+    return;
+  }
+  write(separators.nodeBegin);
+  id(address, name);
+  if (idMode == IdMode::Compact) {
+    key("type");
+    value(name);
+  }
+}
+
+void JsonWriter::endPositionalNode() {
+  auto [index, first] = layouts.end();
+  // The node may be moved to the start of the buffer to make room
+  std::size_t body = size - nodeStart;
+  if (first && layout == JsonLayout::Lines) {
+    write("{\"layout\": ");
+    writeUInt(index);
+    write(", ");
+    writeLayout(layouts.get()[index]);
+    write("}\n");
+  }
+  write(separators.nodeBegin);
+  writeUInt(index);
+  write(separators.property);
+
+  // Moves what was just written in front of the body of the node
+  char *start = buffer.get();
+  std::rotate(start + nodeStart, start + nodeStart + body, start + size);
+  nodeStart = noNode;
+}
+
+void JsonWriter::writeLayout(const PropertyLayouts::Layout &layout) {
+  write("\"type\": ");
+  value(layout.name);
+  write(", \"keys\": [");
+  for (std::size_t i = 0; i < layout.keys.size(); ++i) {
+    if (i > 0)
+      write(", ");
+    value(layout.keys[i]);
+  }
+  write(']');
+}
+
+void JsonWriter::writeLayouts() {
+  write("[\n");
+  const auto &all = layouts.get();
+  for (std::size_t i = 0; i < all.size(); ++i) {
+    if (i > 0)
+      write(",\n");
+    write('{');
+    writeLayout(all[i]);
+    write('}');
+  }
+  write(']');
+}
+
+void JsonWriter::beginDocument(const Document &document) {
+  this->document = document.source;
+  schema = &document.schema;
+  locator = document.locator;
+
+  if (layout == JsonLayout::Lines) {
+    write("{\"file\": ");
+    value(document.file);
+    if (sourceMode == SourceMode::Ranges) {
+      write(", \"source\": ");
+      value(document.source);
+    } else if (sourceMode == SourceMode::Positions) {
+      write(", \"files\": ");
+      writeFiles(document.files);
+    }
+    write(", ");
+    writeSchema(*schema);
+    write("}\n");
+    return;
+  }
+
+  write('{');
+  if (sourceMode == SourceMode::Ranges) {
+    write("\"source\": ");
+    value(document.source);
+    write(",\n");
+  } else if (sourceMode == SourceMode::Positions) {
+    write("\"files\": ");
+    writeFiles(document.files);
+    write(",\n");
+  }
+  write("\"nodes\": [\n");
+}
+
+void JsonWriter::endDocument() {
+  if (layout == JsonLayout::Document) {
+    write("],\n");
+    if (encoding == PropertyEncoding::Positional) {
+      write("\"layouts\": ");
+      writeLayouts();
+      write(",\n");
+    }
+    if (!nodeExtents.empty()) {
+      write("\"extents\": ");
+      writeExtents();
+      write(",\n");
+    }
+    writeSchema(*schema);
+    write("\n}\n");
+  } else if (!nodeExtents.empty()) {
+    write("{\"extents\": ");
+    writeExtents();
+    write("}\n");
+  }
+  flush();
+}
+
+std::unique_ptr<NodeWriter>
+JsonWriter::createFragment(const void * /*root*/, std::string_view /*name*/) {
+  // Layouts are numbered in the order of the dump
+  if (encoding == PropertyEncoding::Positional)
+    return nullptr;
+  return std::unique_ptr<NodeWriter>(
+      new JsonWriter(std::make_unique<Fragment>(), *this));
+}
+
+void JsonWriter::writeFragmentId(const void *address, std::string_view name) {
+  fragment->relocations.push_back({bytesWritten(), address, name});
+}
+
+void JsonWriter::appendFragment(NodeWriter &writer) {
+  auto &part = static_cast<JsonWriter &>(writer);
+  part.flush();
+  part.fragment->os.flush();
+
+  // Nodes shared with the other fragments or the rest of the dump keep the id
+  // they already have
+  std::string_view data = part.fragment->data;
+  std::uint64_t copied = 0;
+  for (const auto &[offset, address, name] : part.fragment->relocations) {
+    write(data.substr(copied, offset - copied));
+    writeUInt(ids.get(address, name));
+    copied = offset;
+  }
+  write(data.substr(copied));
+}
+
+void JsonWriter::writeExtents() {
+  write(separators.arrayBegin);
+  for (std::size_t i = 0; i < nodeExtents.size(); ++i) {
+    const auto &extent = nodeExtents[i];
+    if (i > 0)
+      write(separators.element);
+    write('[');
+    if (extent.parent == NodeExtent::noParent)
+      write("null");
+    else
+      writeUInt(extent.parent);
+    write(", ");
+    writeUInt(extent.depth);
+    write(", ");
+    writeUInt(extent.size);
+    write(']');
+  }
+  write(']');
+}
@@ -0,0 +1,285 @@
+#ifndef __JSON_WRITER_H__
+#define __JSON_WRITER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <llvm/Support/raw_ostream.h>
+
+#include "node_ids.h"
+#include "node_writer.h"
+#include "options.h"
+#include "property_layouts.h"
+
+// === JsonWriter class ===
+//
+// Appends the dump into a fixed, reusable buffer and hands it to the
+// underlying stream in large blocks. Ids, numbers and escaped strings are
+// formatted directly into the buffer, so no temporaries are built per
+// property.
+//
+// With compact ids, references are written as JSON numbers and each node
+// carries its name in a separate "type" field. With source ranges, the
+// source of the file is written once in a top-level "source" field.
+//
+// With the NDJSON layout, the first line is a header record with the file,
+// the source and the enums, and every following line is one node, so the dump
+// can be consumed while it is being written.
+//
+// The enums are written as the precomputed object of their EnumSchema, next to
+// its hash. With EnumMode::Reference, only the hash is written.
+//
+// Fragments write into their own buffer. Their compact ids are left out and
+// numbered by the appending writer, in the order they are referenced, so the
+// dump is the same as if it had been written in one walk.
+//
+// Node extents are written as [parent, depth, size] triples, in an "extents"
+// field after the nodes, or in a last record with the NDJSON layout.
+//
+// With source positions, sources are written as [file, line, column, end
+// line, end column], files being indices into a "files" field written where
+// the source is with source ranges.
+//
+// With the positional encoding, a node is written as an array of the index of
+// its layout, see PropertyLayouts, its id and the values of its properties,
+// without keys. The node is held in the buffer until it ends and its layout
+// is known. The layouts are written in a "layouts" field after the nodes, or
+// in a record before the first node using each with the NDJSON layout.
+// Positional dumps are not split into fragments.
+
+class JsonWriter final : public NodeWriter {
+public:
+  static constexpr std::size_t defaultCapacity = 1 << 20;
+
+  explicit JsonWriter(llvm::raw_ostream &os,
+                      const DumpOptions &options = {},
+                      std::size_t capacity = defaultCapacity);
+  JsonWriter(const JsonWriter &) = delete;
+  JsonWriter &operator=(const JsonWriter &) = delete;
+  ~JsonWriter() override;
+
+  void flush();
+
+  // Raw output
+  void write(char c) {
+    if (size == capacity)
+      makeRoom(1);
+    buffer[size++] = c;
+  }
+
+  void write(std::string_view s) {
+    if (s.size() > capacity - size) {
+      makeRoom(s.size());
+      if (s.size() > capacity - size) {
+        os.write(s.data(), s.size());
+        flushed += s.size();
+        return;
+      }
+    }
+    std::memcpy(buffer.get() + size, s.data(), s.size());
+    size += s.size();
+  }
+
+  void writeUInt(std::uint64_t v);
+  void writeInt(std::int64_t v);
+  void writeHex(std::uintptr_t v);
+  void writeEscaped(std::string_view s);
+
+  // Document
+  void beginDocument(const Document &document) override;
+  void endDocument() override;
+
+  // Nodes
+  void beginNode(const void *address, std::string_view name) override;
+  void endNode() override {
+    if (nodeStart != noNode)
+      endPositionalNode();
+    write(separators.nodeEnd);
+  }
+
+  // Properties. Every value is written as a JSON string.
+  void key(std::string_view name) override {
+    if (nodeStart != noNode) {
+      layouts.key(name);
+      write(separators.property);
+      return;
+    }
+    write(separators.property);
+    write(name);
+    write("\": ");
+  }
+
+  void key(std::string_view name, std::string_view argument) override {
+    if (nodeStart != noNode) {
+      layouts.key(name, argument);
+      write(separators.property);
+      return;
+    }
+    write(separators.property);
+    write(name);
+    write('<');
+    write(argument);
+    write(">\": ");
+  }
+
+  using NodeWriter::value;
+
+  void value(std::string_view v) override {
+    write('"');
+    writeEscaped(v);
+    write('"');
+  }
+
+  void value(std::uint64_t v) override {
+    write('"');
+    writeUInt(v);
+    write('"');
+  }
+
+  void value(int v) override {
+    write('"');
+    writeInt(v);
+    write('"');
+  }
+
+  void value(bool v) override { write(v ? "\"1\"" : "\"0\""); }
+
+  void source(std::string_view text) override {
+    if (sourceMode == SourceMode::Positions && locator) {
+      position(locator->locate(text, cursor));
+      return;
+    }
+    if (sourceMode == SourceMode::Ranges && text.data() >= document.data() &&
+        text.data() + text.size() <= document.data() + document.size()) {
+      write('[');
+      writeUInt(text.data() - document.data());
+      write(", ");
+      writeUInt(text.size());
+      write(']');
+      return;
+    }
+    value(text);
+  }
+
+  void position(const SourceRange &range) override;
+
+  void id(const void *address, std::string_view name) override {
+    if (idMode == IdMode::Compact) {
+      if (fragment)
+        writeFragmentId(address, name);
+      else
+        writeUInt(ids.get(address, name));
+      return;
+    }
+    write('"');
+    writeId(address, name);
+    write('"');
+  }
+
+  void nullId() override {
+    write(idMode == IdMode::Compact ? "null" : "\"null\"");
+  }
+
+  // Arrays of ids
+  void beginArray() override {
+    write(separators.arrayBegin);
+    firstElement = true;
+  }
+
+  void element() override {
+    if (!firstElement)
+      write(separators.element);
+    firstElement = false;
+  }
+
+  void endArray() override { write("]"); }
+
+  // Written when the document ends
+  void extents(llvm::ArrayRef<NodeExtent> extents) override {
+    nodeExtents = extents;
+  }
+
+  std::unique_ptr<NodeWriter> createFragment(const void *root,
+                                             std::string_view name) override;
+  void appendFragment(NodeWriter &fragment) override;
+
+  std::uint64_t bytesWritten() const override { return flushed + size; }
+
+private:
+  // Output of a fragment, and the nodes whose compact ids go into it
+  struct Fragment {
+    struct Relocation {
+      std::uint64_t offset;
+      const void *address;
+      std::string_view name;
+    };
+
+    std::string data;
+    llvm::raw_string_ostream os{data};
+    std::vector<Relocation> relocations;
+  };
+
+  JsonWriter(std::unique_ptr<Fragment> fragment, const JsonWriter &parent);
+
+  // Punctuation that differs between the layouts
+  struct Separators {
+    std::string_view node;     // Between two nodes
+    std::string_view nodeBegin;
+    std::string_view nodeEnd;
+    std::string_view property; // Before a key, up to its opening quote, or
+                               // before a positional value
+    std::string_view arrayBegin;
+    std::string_view element;  // Between two elements of an array or enum
+  };
+
+  static const Separators documentSeparators;
+  static const Separators lineSeparators;
+  static const Separators positionalDocumentSeparators;
+  static const Separators positionalLineSeparators;
+  static const Separators &separatorsFor(JsonLayout layout,
+                                         PropertyEncoding encoding);
+
+  // Not a positional node being held
+  static constexpr std::size_t noNode = ~std::size_t(0);
+
+  // Flushes the buffer, or frees or grows it while a positional node is held
+  void makeRoom(std::size_t bytes);
+  void endPositionalNode();
+  void writeLayout(const PropertyLayouts::Layout &layout);
+  void writeLayouts();
+  void writeId(const void *address, std::string_view name);
+  void writeFiles(llvm::ArrayRef<std::string> files);
+  void writeSchema(const EnumSchema &schema);
+  void writeExtents();
+  void writeFragmentId(const void *address, std::string_view name);
+
+  llvm::raw_ostream &os;
+  IdMode idMode;
+  SourceMode sourceMode;
+  JsonLayout layout;
+  EnumMode enumMode;
+  PropertyEncoding encoding;
+  const Separators &separators;
+  const EnumSchema *schema = nullptr;
+  llvm::ArrayRef<NodeExtent> nodeExtents;
+  std::string_view document;
+  const SourceLocator *locator = nullptr;
+  std::size_t cursor = 0; // Of locator
+  NodeIds ids;
+  PropertyLayouts layouts;
+  std::size_t nodeStart = noNode; // In the buffer, of the positional node
+  std::unique_ptr<char[]> buffer;
+  std::size_t capacity;
+  std::size_t size = 0;
+  std::uint64_t flushed = 0;
+  bool firstNode = true;
+  bool firstElement = true;
+  std::unique_ptr<Fragment> fragment; // If this writer is a fragment
+};
+
+#endif // __JSON_WRITER_H__
@@ -0,0 +1,152 @@
+#include <algorithm>
+
+#include <llvm/ADT/StringMap.h>
+
+#include "line_map.h"
+
+LineMap::LineMap(const Fortran::parser::Parsing &parsing)
+    : cooked(parsing.cooked().AsCharBlock()) {
+  const auto &allCooked = parsing.allCooked();
+  llvm::StringMap<std::uint32_t> fileIds;
+
+  auto at = [&](const char *p) {
+    Segment segment{p, SourceRange::noFile, 0, 0};
+    auto range =
+        allCooked.GetSourcePositionRange(Fortran::parser::CharBlock{p, 1});
+    if (!range)
+      return segment;
+    const auto &position = range->first;
+    const std::string &path = position.path;
+    auto [it, inserted] = fileIds.try_emplace(path, paths.size());
+    if (inserted)
+      paths.push_back(path);
+    segment.file = it->second;
+    segment.line = position.line;
+    segment.column = position.column;
+    return segment;
+  };
+
+  // Whether `next`, the segment at `p`, continues `segment`: on the same line
+  // of the same file, as many columns after its start as characters
+  auto continues = [](const Segment &segment, const Segment &next,
+                      const char *p) {
+    if (segment.file == SourceRange::noFile)
+      return next.file == SourceRange::noFile;
+    return next.file == segment.file && next.line == segment.line &&
+           next.column == segment.column + (p - segment.begin);
+  };
+
+  // Offset from `p` of the last character of `segment`, at most `last`,
+  // checking every character
+  auto scan = [&](const Segment &segment, const char *p, std::size_t last) {
+    std::size_t offset = 0;
+    while (offset < last &&
+           continues(segment, at(p + offset + 1), p + offset + 1))
+      ++offset;
+    return offset;
+  };
+
+  for (const char *p = cooked.begin(); p < cooked.end();) {
+    // The newline ends the last segment of its line
+    const char *end = std::find(p, cooked.end(), '\n');
+    do {
+      Segment segment = at(p);
+      segments.push_back(segment);
+      std::size_t last = end > p ? end - p - 1 : 0;
+
+      // A cooked line is usually one segment, or a few when it is made of
+      // continuation lines, so the end of the segment is searched for
+      // instead of checking every character. The search assumes that the
+      // characters of the segment come first, which text without a position,
+      // such as inserted blanks, breaks: the characters are then checked one
+      // by one.
+      std::size_t low = 0;
+      if (segment.file == SourceRange::noFile) {
+        low = scan(segment, p, last);
+      } else if (last > 0 && !continues(segment, at(p + last), p + last)) {
+        std::size_t high = last - 1;
+        while (low < high) {
+          std::size_t middle = low + (high - low + 1) / 2;
+          Segment next = at(p + middle);
+          if (next.file == SourceRange::noFile) {
+            low = scan(segment, p, last);
+            break;
+          }
+          if (continues(segment, next, p + middle))
+            low = middle;
+          else
+            high = middle - 1;
+        }
+      } else {
+        low = last;
+      }
+      p += low + 1;
+    } while (p < end);
+    p = end == cooked.end() ? end : end + 1;
+  }
+}
+
+std::size_t LineMap::find(const char *p, std::size_t &cursor) const {
+  auto contains = [&](std::size_t i) {
+    return segments[i].begin <= p &&
+           (i + 1 == segments.size() || p < segments[i + 1].begin);
+  };
+  if (cursor < segments.size()) {
+    if (contains(cursor))
+      return cursor;
+    if (cursor + 1 < segments.size() && contains(cursor + 1))
+      return ++cursor;
+  }
+
+  auto it = std::upper_bound(
+      segments.begin(), segments.end(), p,
+      [](const char *p, const Segment &segment) { return p < segment.begin; });
+  return cursor = it - segments.begin() - 1;
+}
+
+std::string LineMap::provenance() const {
+  std::string result;
+  for (const auto &path : paths) {
+    result += path;
+    result += '\0';
+  }
+  for (const auto &segment : segments) {
+    std::uint64_t offset = segment.begin - cooked.begin();
+    result.append(reinterpret_cast<const char *>(&offset), sizeof(offset));
+    result.append(reinterpret_cast<const char *>(&segment.file),
+                  sizeof(segment.file));
+    result.append(reinterpret_cast<const char *>(&segment.line),
+                  sizeof(segment.line));
+    result.append(reinterpret_cast<const char *>(&segment.column),
+                  sizeof(segment.column));
+  }
+  return result;
+}
+
+int LineMap::line(const char *p) const {
+  if (p < cooked.begin() || p >= cooked.end())
+    return 0;
+  std::size_t cursor = 0;
+  return segments[find(p, cursor)].line;
+}
+
+SourceRange LineMap::locate(std::string_view text,
+                            std::size_t &cursor) const {
+  const char *first = text.data();
+  const char *last = text.empty() ? first : first + text.size() - 1;
+  if (first < cooked.begin() || last >= cooked.end())
+    return {SourceRange::noFile, 0, 0, 0, 0};
+
+  const auto &begin = segments[find(first, cursor)];
+  if (begin.file == SourceRange::noFile)
+    return {SourceRange::noFile, 0, 0, 0, 0};
+  std::uint32_t column = begin.column + (first - begin.begin);
+
+  // The cursor follows the starts, which are in the order of the source
+  std::size_t endCursor = cursor;
+  const auto &end = segments[find(last, endCursor)];
+  if (end.file != begin.file)
+    return {begin.file, begin.line, column, begin.line, column};
+  return {begin.file, begin.line, column, end.line,
+          std::uint32_t(end.column + (last - end.begin))};
+}
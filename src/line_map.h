@@ -0,0 +1,67 @@
+#ifndef __LINE_MAP_H__
+#define __LINE_MAP_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "flang/Parser/char-block.h"
+#include "flang/Parser/parsing.h"
+
+#include "node_writer.h"
+
+// === LineMap class ===
+//
+// Maps positions in the cooked source back to lines and columns of the
+// original files, through the provenance of the characters. The cooked source
+// is split once into segments, runs of characters that follow each other on
+// one line of one file, so a position is mapped with a binary search, or
+// none when the lookups follow the order of the source. INCLUDE lines are
+// expanded in the cooked source; their text maps to the included files, and
+// the text of macro expansions to where the macros are used.
+
+class LineMap final : public SourceLocator {
+public:
+  explicit LineMap(const Fortran::parser::Parsing &parsing);
+
+  // Original line of `p`, or 0 if it is not in the cooked source
+  int line(const char *p) const;
+
+  // First and last lines of `block`
+  std::pair<int, int> lines(Fortran::parser::CharBlock block) const {
+    if (block.empty())
+      return {line(block.begin()), line(block.begin())};
+    return {line(block.begin()), line(block.end() - 1)};
+  }
+
+  // Paths of the original files, indexed by SourceRange::file
+  const std::vector<std::string> &files() const { return paths; }
+
+  // Files and segments of the map, in a form that changes whenever a position
+  // does, for the key of the dump cache
+  std::string provenance() const;
+
+  // A range that ends in another file than it starts in ends where it starts
+  SourceRange locate(std::string_view text,
+                     std::size_t &cursor) const override;
+
+private:
+  struct Segment {
+    const char *begin;
+    std::uint32_t file; // SourceRange::noFile if it has no position
+    std::uint32_t line;
+    std::uint32_t column;
+  };
+
+  // Segment of `p`, which is in the cooked source
+  std::size_t find(const char *p, std::size_t &cursor) const;
+
+  Fortran::parser::CharBlock cooked;
+  std::vector<Segment> segments;
+  std::vector<std::string> paths;
+};
+
+#endif // __LINE_MAP_H__
@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+
+#include "mapped_file_stream.h"
+
+namespace fs = llvm::sys::fs;
+
+std::unique_ptr<MappedFileStream>
+MappedFileStream::create(llvm::StringRef path, std::error_code &ec) {
+  int fd;
+  // Mapping for writing needs a file opened for reading too
+  ec = fs::openFileForReadWrite(path, fd, fs::CD_CreateAlways, fs::OF_None);
+  if (ec)
+    return nullptr;
+  return std::unique_ptr<MappedFileStream>(new MappedFileStream(fd));
+}
+
+MappedFileStream::MappedFileStream(int fd) : fd(fd) { SetUnbuffered(); }
+
+MappedFileStream::~MappedFileStream() { close(); }
+
+bool MappedFileStream::mapExtent() {
+  // Written up to the end of the previous extent, which is page aligned
+  region.reset();
+  regionOffset = written;
+  // Allocates the blocks of the extent, instead of leaving a hole, so a full
+  // disk fails here rather than raising SIGBUS when the mapping is written
+  if (int error = posix_fallocate(fd, regionOffset, extentSize)) {
+    ec = std::error_code(error, std::generic_category());
+    return false;
+  }
+  region = std::make_unique<fs::mapped_file_region>(
+      fd, fs::mapped_file_region::readwrite, extentSize, regionOffset, ec);
+  if (ec) {
+    region.reset();
+    return false;
+  }
+  return true;
+}
+
+void MappedFileStream::write_impl(const char *ptr, std::size_t size) {
+  while (size > 0 && !ec) {
+    std::uint64_t used = written - regionOffset;
+    if (!region || used == extentSize) {
+      if (!mapExtent())
+        return;
+      used = 0;
+    }
+    std::size_t chunk = std::min<std::uint64_t>(size, extentSize - used);
+    std::memcpy(region->data() + used, ptr, chunk);
+    written += chunk;
+    ptr += chunk;
+    size -= chunk;
+  }
+}
+
+std::error_code MappedFileStream::close() {
+  if (closed)
+    return ec;
+  closed = true;
+  flush();
+  region.reset();
+  // Drops the unused part of the last extent
+  if (std::error_code error = fs::resize_file(fd, written); error && !ec)
+    ec = error;
+  if (std::error_code error = fs::closeFile(fd); error && !ec)
+    ec = error;
+  return ec;
+}
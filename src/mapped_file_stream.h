@@ -0,0 +1,55 @@
+#ifndef __MAPPED_FILE_STREAM_H__
+#define __MAPPED_FILE_STREAM_H__
+
+#include <cstdint>
+#include <memory>
+#include <system_error>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+
+// === MappedFileStream class ===
+//
+// Writes a file through memory mappings instead of write calls. The file is
+// grown by large extents allocated with posix_fallocate, so running out of
+// space is reported as an error instead of a SIGBUS on the mapping. Each
+// extent is mapped and filled in turn, and the file is truncated to the bytes
+// written when the stream is closed.
+//
+// The stream is unbuffered, since the writers hand over large blocks.
+
+class MappedFileStream final : public llvm::raw_ostream {
+public:
+  static constexpr std::uint64_t extentSize = 64 << 20;
+
+  // Creates or truncates `path`
+  static std::unique_ptr<MappedFileStream> create(llvm::StringRef path,
+                                                  std::error_code &ec);
+
+  ~MappedFileStream() override;
+
+  // Unmaps, truncates and closes the file. Returns the first error met
+  // while writing or closing.
+  std::error_code close();
+
+  std::error_code error() const { return ec; }
+
+private:
+  explicit MappedFileStream(int fd);
+
+  void write_impl(const char *ptr, std::size_t size) override;
+  std::uint64_t current_pos() const override { return written; }
+
+  // Allocates the next extent of the file and maps it
+  bool mapExtent();
+
+  int fd;
+  std::unique_ptr<llvm::sys::fs::mapped_file_region> region;
+  std::uint64_t regionOffset = 0; // Of the mapped extent in the file
+  std::uint64_t written = 0;
+  std::error_code ec;
+  bool closed = false;
+};
+
+#endif // __MAPPED_FILE_STREAM_H__
@@ -0,0 +1,130 @@
+#include <algorithm>
+#include <optional>
+#include <tuple>
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/Path.h>
+
+#include "flang/Parser/parse-tree-visitor.h"
+
+#include "modules.h"
+
+namespace parser = Fortran::parser;
+
+namespace {
+
+// Names are lowercase in the cooked source, like the names of .mod files
+std::string moduleName(const parser::Name &name) {
+  return llvm::StringRef(name.source.begin(), name.source.size()).lower();
+}
+
+struct ModuleVisitor {
+  ModuleInfo &info;
+
+  template <typename A> bool Pre(const A &) { return true; }
+  template <typename A> void Post(const A &) {}
+
+  bool Pre(const parser::ModuleStmt &v) {
+    info.defines.push_back(moduleName(v.v));
+    return false;
+  }
+
+  // A submodule needs the module it extends, and its parent submodule if it
+  // has one
+  bool Pre(const parser::SubmoduleStmt &v) {
+    const auto &parent = std::get<parser::ParentIdentifier>(v.t);
+    auto ancestor = moduleName(std::get<parser::Name>(parent.t));
+    info.defines.push_back(ancestor + ":" +
+                           moduleName(std::get<parser::Name>(v.t)));
+    info.uses.push_back(ancestor);
+    if (const auto &name = std::get<std::optional<parser::Name>>(parent.t))
+      info.uses.push_back(ancestor + ":" + moduleName(*name));
+    return false;
+  }
+
+  bool Pre(const parser::UseStmt &v) {
+    if (v.nature != parser::UseStmt::ModuleNature::Intrinsic)
+      info.uses.push_back(moduleName(v.moduleName));
+    return false;
+  }
+
+  // None of these statements are found in expressions
+  bool Pre(const parser::Expr &) { return false; }
+};
+
+void sortUnique(std::vector<std::string> &names) {
+  std::sort(names.begin(), names.end());
+  names.erase(std::unique(names.begin(), names.end()), names.end());
+}
+
+} // namespace
+
+void ScanModules::executeAction() {
+  ModuleVisitor visitor{info};
+  parser::Walk(getParsing().parseTree(), visitor);
+
+  // The modules of the file itself are compiled along with it
+  sortUnique(info.defines);
+  sortUnique(info.uses);
+  info.uses.erase(std::remove_if(info.uses.begin(), info.uses.end(),
+                                 [&](const std::string &name) {
+                                   return std::binary_search(
+                                       info.defines.begin(),
+                                       info.defines.end(), name);
+                                 }),
+                  info.uses.end());
+}
+
+ModuleGraph::ModuleGraph(llvm::ArrayRef<std::string> files,
+                         llvm::ArrayRef<ModuleInfo> modules)
+    : edges(files.size()) {
+  llvm::StringMap<std::vector<std::size_t>> definers;
+  for (std::size_t i = 0; i < modules.size(); ++i)
+    for (const auto &name : modules[i].defines)
+      definers[name].push_back(i);
+
+  for (std::size_t i = 0; i < modules.size(); ++i) {
+    auto directory = llvm::sys::path::parent_path(files[i]);
+    auto &dependencies = edges[i].dependencies;
+    for (const auto &name : modules[i].uses) {
+      auto it = definers.find(name);
+      if (it == definers.end())
+        continue;
+
+      const auto &candidates = it->second;
+      auto local = std::find_if(
+          candidates.begin(), candidates.end(), [&](std::size_t file) {
+            return llvm::sys::path::parent_path(files[file]) == directory;
+          });
+      std::size_t definer =
+          local != candidates.end() ? *local : candidates.front();
+      if (definer != i)
+        dependencies.push_back(definer);
+    }
+
+    std::sort(dependencies.begin(), dependencies.end());
+    dependencies.erase(std::unique(dependencies.begin(), dependencies.end()),
+                       dependencies.end());
+    for (auto dependency : dependencies)
+      edges[dependency].dependents.push_back(i);
+  }
+}
+
+std::vector<std::size_t> ModuleGraph::closure(std::size_t i) const {
+  std::vector<std::size_t> files;
+  std::vector<bool> visited(edges.size());
+  std::vector<std::size_t> stack(edges[i].dependencies.begin(),
+                                 edges[i].dependencies.end());
+  visited[i] = true;
+  while (!stack.empty()) {
+    auto file = stack.back();
+    stack.pop_back();
+    if (visited[file])
+      continue;
+    visited[file] = true;
+    files.push_back(file);
+    stack.insert(stack.end(), edges[file].dependencies.begin(),
+                 edges[file].dependencies.end());
+  }
+  return files;
+}
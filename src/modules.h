@@ -0,0 +1,73 @@
+#ifndef __MODULES_H__
+#define __MODULES_H__
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/StringRef.h>
+
+#include "flang/Frontend/FrontendActions.h"
+
+// Modules a file defines and uses. Submodules are named
+// "<ancestor>:<submodule>", the way their .smod files are.
+struct ModuleInfo {
+  std::vector<std::string> defines;
+  std::vector<std::string> uses; // Without the intrinsic modules
+};
+
+// === ScanModules action ===
+//
+// Fills a ModuleInfo from the ModuleStmt, SubmoduleStmt and UseStmt nodes of
+// the input, without dumping anything. Only parses, so it does not need the
+// modules the input uses.
+
+class ScanModules : public Fortran::frontend::PluginParseTreeAction {
+public:
+  explicit ScanModules(ModuleInfo &info) : info(info) {}
+
+protected:
+  void executeAction() override;
+
+private:
+  ModuleInfo &info;
+};
+
+// === ModuleGraph class ===
+//
+// Dependencies between files through their modules: a file depends on the
+// files defining the modules it uses. When several files define a module, a
+// user depends on the one in its own directory if there is one, and otherwise
+// on the first one. Modules that no file defines are assumed to be available
+// already.
+
+class ModuleGraph {
+public:
+  ModuleGraph(llvm::ArrayRef<std::string> files,
+              llvm::ArrayRef<ModuleInfo> modules);
+
+  // Files defining the modules that file `i` uses
+  llvm::ArrayRef<std::size_t> dependencies(std::size_t i) const {
+    return edges[i].dependencies;
+  }
+
+  // Files using the modules that file `i` defines
+  llvm::ArrayRef<std::size_t> dependents(std::size_t i) const {
+    return edges[i].dependents;
+  }
+
+  // Dependencies of file `i`, and theirs recursively, each once: the files
+  // whose modules may be read while compiling it
+  std::vector<std::size_t> closure(std::size_t i) const;
+
+private:
+  struct Edges {
+    std::vector<std::size_t> dependencies;
+    std::vector<std::size_t> dependents;
+  };
+
+  std::vector<Edges> edges;
+};
+
+#endif // __MODULES_H__
@@ -0,0 +1,32 @@
+#ifndef __NODE_IDS_H__
+#define __NODE_IDS_H__
+
+#include <cstdint>
+#include <utility>
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/StringRef.h>
+
+// === NodeIds class ===
+//
+// Assigns dense sequential ids to nodes, in the order they are first
+// referenced during the walk. A node is identified by its address and its
+// name, since a node and its first member share the same address.
+
+class NodeIds {
+public:
+  std::uint32_t get(const void *address, llvm::StringRef name) {
+    auto [it, inserted] = ids.try_emplace({address, name}, next);
+    if (inserted)
+      ++next;
+    return it->second;
+  }
+
+  std::uint32_t size() const { return next; }
+
+private:
+  llvm::DenseMap<std::pair<const void *, llvm::StringRef>, std::uint32_t> ids;
+  std::uint32_t next = 0;
+};
+
+#endif // __NODE_IDS_H__
@@ -0,0 +1,94 @@
+#ifndef __NODE_TRAITS_H__
+#define __NODE_TRAITS_H__
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "flang/Parser/dump-parse-tree.h"
+#include "flang/Parser/parse-tree.h"
+
+template <typename T, template <typename...> class Template>
+struct is_specialization : std::false_type {};
+
+template <typename... Args, template <typename...> class Template>
+struct is_specialization<Template<Args...>, Template> : std::true_type {};
+
+// Stands for a node of type T when its name is computed. It is only bound to
+// references in constant expressions, so it is never defined.
+#if defined(__clang__)
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wundefined-var-template"
+#endif
+template <typename T> extern const T nodeObject;
+
+// Unqualified name of T, e.g. "ModuleNature" for
+// Fortran::parser::UseStmt::ModuleNature
+template <typename T> constexpr std::string_view typeName() {
+  std::string_view function = __PRETTY_FUNCTION__;
+  auto begin = function.find("T = ") + 4;
+  auto end = function.find_first_of(";]", begin);
+  auto name = function.substr(begin, end - begin);
+  auto scope = name.rfind("::");
+  return scope == std::string_view::npos ? name : name.substr(scope + 2);
+}
+
+// Name of a node type, see NodeTraits
+template <typename T> constexpr std::string_view nodeName() {
+  using Dumper = Fortran::parser::ParseTreeDumper;
+
+  if constexpr (is_specialization<T, Fortran::parser::Statement>::value) {
+    return "Statement";
+  } else if constexpr (is_specialization<
+                           T, Fortran::parser::UnlabeledStatement>::value) {
+    return "UnlabeledStatement";
+  } else if constexpr (is_specialization<T, Fortran::parser::Scalar>::value ||
+                       is_specialization<T, Fortran::parser::Constant>::value ||
+                       is_specialization<T, Fortran::parser::Integer>::value ||
+                       is_specialization<T, Fortran::parser::Logical>::value) {
+    return "Expr";
+  } else if constexpr (is_specialization<T,
+                                         Fortran::parser::DefaultChar>::value) {
+    return "DefaultChar";
+  } else if constexpr (std::is_same_v<T, Fortran::parser::CharBlock>) {
+    return "CharBlock";
+  } else if constexpr (std::is_same_v<decltype(Dumper::GetNodeName(
+                                          std::declval<const T &>())),
+                                      std::string>) {
+    return typeName<T>();
+  } else {
+    return Dumper::GetNodeName(nodeObject<T>);
+  }
+}
+
+// === NodeTraits class ===
+//
+// Name of each node type, computed at compile time. Names are those of
+// ParseTreeDumper, except for the wrapper templates that are dumped under a
+// common name, and for enums: ParseTreeDumper names them after their value,
+// so they are named after their type instead.
+
+template <typename T> struct NodeTraits {
+private:
+  static constexpr std::string_view view = nodeName<T>();
+
+  // NUL-terminated copy, so that the name does not point into
+  // __PRETTY_FUNCTION__
+  static constexpr auto storage = [] {
+    std::array<char, view.size() + 1> chars{};
+    for (std::size_t i = 0; i < view.size(); ++i)
+      chars[i] = view[i];
+    return chars;
+  }();
+
+public:
+  static constexpr std::string_view name{storage.data(), view.size()};
+};
+#if defined(__clang__)
+#pragma clang diagnostic pop
+#endif
+
+#endif // __NODE_TRAITS_H__
@@ -0,0 +1,122 @@
+#ifndef __NODE_WRITER_H__
+#define __NODE_WRITER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+
+#include <llvm/ADT/ArrayRef.h>
+
+#include "enum_schema.h"
+
+// Where a piece of the cooked source comes from: a file of Document::files,
+// and the line and column of its first and last characters, counted from 1
+struct SourceRange {
+  static constexpr std::uint32_t noFile = 0xffffffff;
+
+  std::uint32_t file; // noFile if the text is not from the original files
+  std::uint32_t line;
+  std::uint32_t column;
+  std::uint32_t endLine;
+  std::uint32_t endColumn;
+};
+
+// Maps views into the cooked source to their original files. `cursor` is
+// kept by the caller between lookups, which are cheapest when they follow the
+// order of the source.
+class SourceLocator {
+public:
+  virtual ~SourceLocator() = default;
+  virtual SourceRange locate(std::string_view text,
+                             std::size_t &cursor) const = 0;
+};
+
+// Input the dump is made from
+struct Document {
+  // Cooked source of the file. The source of every node is a view into it.
+  std::string_view source;
+  // Path of the file, may be empty
+  std::string_view file;
+  // Enums whose values are referred to by the nodes
+  const EnumSchema &schema;
+  // Original files of the source, with SourceMode::Positions
+  llvm::ArrayRef<std::string> files = {};
+  // Positions of the source of the nodes, with SourceMode::Positions.
+  // Replayed documents have none, their positions are given to
+  // NodeWriter::position directly.
+  const SourceLocator *locator = nullptr;
+};
+
+// Position of a node in the tree, for the node at the same index in the order
+// of the dump. Nodes are dumped in pre-order, so the subtree of node i is the
+// nodes i to i + size - 1.
+struct NodeExtent {
+  static constexpr std::uint32_t noParent = 0xffffffff;
+
+  std::uint32_t parent; // Index of the parent, or noParent for a root
+  std::uint32_t depth;
+  std::uint32_t size; // Nodes in the subtree, including this one
+};
+
+// === NodeWriter class ===
+//
+// Output format of the dump. ParseTreeVisitor describes every node as an id
+// followed by its properties, and each writer serializes that description.
+
+class NodeWriter {
+public:
+  virtual ~NodeWriter() = default;
+
+  // Document
+  virtual void beginDocument(const Document &document) = 0;
+  virtual void endDocument() = 0;
+
+  // Nodes
+  virtual void beginNode(const void *address, std::string_view name) = 0;
+  virtual void endNode() = 0;
+
+  // Properties. A key is followed by a value, an id or an array of ids.
+  virtual void key(std::string_view name) = 0;
+  virtual void key(std::string_view name, std::string_view argument) = 0;
+
+  virtual void value(std::string_view v) = 0;
+  virtual void value(std::uint64_t v) = 0;
+  virtual void value(int v) = 0;
+  virtual void value(bool v) = 0;
+  void value(const char *v) { value(std::string_view{v}); }
+
+  // Source text of a node, a view into the source of the document
+  virtual void source(std::string_view text) = 0;
+  // Original position of the source of a node, what source() writes with
+  // SourceMode::Positions
+  virtual void position(const SourceRange &range) = 0;
+
+  virtual void id(const void *address, std::string_view name) = 0;
+  virtual void nullId() = 0;
+
+  // Arrays of ids
+  virtual void beginArray() = 0;
+  virtual void element() = 0;
+  virtual void endArray() = 0;
+
+  // Extents of the nodes dumped so far. The array lives until the document
+  // ends.
+  virtual void extents(llvm::ArrayRef<NodeExtent> extents) = 0;
+
+  // Parallel dumps. A fragment writes the subtree rooted at `root` on another
+  // thread, and is then appended to this writer, fragments in the order of
+  // the walk. The result is the same as dumping the subtrees in place. Writers
+  // that cannot be split return nullptr.
+  virtual std::unique_ptr<NodeWriter>
+  createFragment(const void * /*root*/, std::string_view /*name*/) {
+    return nullptr;
+  }
+  virtual void appendFragment(NodeWriter & /*fragment*/) {}
+
+  // Size of the output produced so far, in bytes
+  virtual std::uint64_t bytesWritten() const = 0;
+};
+
+#endif // __NODE_WRITER_H__
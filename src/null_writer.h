@@ -0,0 +1,50 @@
+#ifndef __NULL_WRITER_H__
+#define __NULL_WRITER_H__
+
+#include <cstdint>
+
+#include "node_writer.h"
+
+// === NullWriter class ===
+//
+// Discards the dump and only counts the nodes, so that the walk over the parse
+// tree can be measured without the cost of an output format.
+
+class NullWriter final : public NodeWriter {
+public:
+  std::uint64_t nodes() const { return nodeCount; }
+
+  void beginDocument(const Document &) override {}
+  void endDocument() override {}
+
+  void beginNode(const void *, std::string_view) override { ++nodeCount; }
+  void endNode() override {}
+
+  void key(std::string_view) override {}
+  void key(std::string_view, std::string_view) override {}
+
+  using NodeWriter::value;
+  void value(std::string_view) override {}
+  void value(std::uint64_t) override {}
+  void value(int) override {}
+  void value(bool) override {}
+
+  void source(std::string_view) override {}
+  void position(const SourceRange &) override {}
+
+  void id(const void *, std::string_view) override {}
+  void nullId() override {}
+
+  void beginArray() override {}
+  void element() override {}
+  void endArray() override {}
+
+  void extents(llvm::ArrayRef<NodeExtent>) override {}
+
+  std::uint64_t bytesWritten() const override { return 0; }
+
+private:
+  std::uint64_t nodeCount = 0;
+};
+
+#endif // __NULL_WRITER_H__
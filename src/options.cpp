@@ -0,0 +1,282 @@
+#include <optional>
+
+#include <llvm/ADT/StringSwitch.h>
+#include <llvm/Support/CommandLine.h>
+
+#include "options.h"
+#include "selection.h"
+
+static llvm::cl::OptionCategory dumperCategory("flang-dumper options");
+
+static llvm::cl::opt<IdMode> idMode(
+    "dump-ast-ids", llvm::cl::desc("Format of the node ids"),
+    llvm::cl::values(
+        clEnumValN(IdMode::Address, "address",
+                   "\"0x<address>-<NodeName>\" strings (default)"),
+        clEnumValN(IdMode::Compact, "compact",
+                   "Sequential integers, stable across runs")),
+    llvm::cl::init(IdMode::Address), llvm::cl::cat(dumperCategory));
+
+static llvm::cl::opt<SourceMode> sourceMode(
+    "dump-ast-source", llvm::cl::desc("Format of the source of the nodes"),
+    llvm::cl::values(
+        clEnumValN(SourceMode::Text, "text",
+                   "The source text of each node (default)"),
+        clEnumValN(SourceMode::Ranges, "ranges",
+                   "[offset, length] into the cooked source of the file, "
+                   "which is written once"),
+        clEnumValN(SourceMode::Positions, "positions",
+                   "[file, line, column, end line, end column] in the "
+                   "original files, INCLUDE files and macro uses included")),
+    llvm::cl::init(SourceMode::Text), llvm::cl::cat(dumperCategory));
+
+static llvm::cl::opt<JsonLayout> jsonLayout(
+    "dump-ast-layout", llvm::cl::desc("Layout of the JSON dump"),
+    llvm::cl::values(
+        clEnumValN(JsonLayout::Document, "document",
+                   "A single JSON object (default)"),
+        clEnumValN(JsonLayout::Lines, "ndjson",
+                   "Newline-delimited JSON, a header record and then one "
+                   "node per line")),
+    llvm::cl::init(JsonLayout::Document), llvm::cl::cat(dumperCategory));
+
+static llvm::cl::opt<EnumMode> enumMode(
+    "dump-ast-enums", llvm::cl::desc("How the JSON dump gives the enums"),
+    llvm::cl::values(
+        clEnumValN(EnumMode::Inline, "inline",
+                   "The enums and their schema hash (default)"),
+        clEnumValN(EnumMode::Reference, "reference",
+                   "Only the schema hash, see the dump-ast-schema action")),
+    llvm::cl::init(EnumMode::Inline), llvm::cl::cat(dumperCategory));
+
+static llvm::cl::opt<PropertyEncoding> propertyEncoding(
+    "dump-ast-encoding", llvm::cl::desc("How the JSON dump writes the nodes"),
+    llvm::cl::values(
+        clEnumValN(PropertyEncoding::Named, "named",
+                   "An object with the key of every property (default)"),
+        clEnumValN(PropertyEncoding::Positional, "positional",
+                   "An array with the layout, id and values, the keys of "
+                   "each layout being written once")),
+    llvm::cl::init(PropertyEncoding::Named), llvm::cl::cat(dumperCategory));
+
+static llvm::cl::opt<std::string> outputPath(
+    "dump-ast-output",
+    llvm::cl::desc("Write the dump to this file instead of stdout, through "
+                   "memory mappings of preallocated extents"),
+    llvm::cl::value_desc("path"), llvm::cl::cat(dumperCategory));
+
+static llvm::cl::opt<std::string> profilePath(
+    "dump-ast-profile",
+    llvm::cl::desc("Write the visits, bytes and time of each node type to "
+                   "this file, as CSV if it ends with .csv and JSON "
+                   "otherwise"),
+    llvm::cl::value_desc("path"), llvm::cl::cat(dumperCategory));
+
+static llvm::cl::opt<unsigned> dumpThreads(
+    "dump-ast-threads",
+    llvm::cl::desc("Dump the program units of a file on this many threads; "
+                   "the output is the same as with 1 (default)"),
+    llvm::cl::init(1), llvm::cl::cat(dumperCategory));
+
+static llvm::cl::opt<bool> nodeExtents(
+    "dump-ast-extents",
+    llvm::cl::desc("Write the parent, depth and subtree size of every node, "
+                   "indexed by its position in the dump"),
+    llvm::cl::cat(dumperCategory));
+
+static llvm::cl::opt<bool> dagOutput(
+    "dump-ast-dag",
+    llvm::cl::desc("Dump identical subtrees once, later ones referring to "
+                   "the first with a sameAs property"),
+    llvm::cl::cat(dumperCategory));
+
+static llvm::cl::opt<std::string> selectText(
+    "dump-ast-select",
+    llvm::cl::desc("Only dump the nodes selected by these comma-separated "
+                   "terms: unit=<name>, kind=<NodeName>, lines=<a>-<b>"),
+    llvm::cl::value_desc("selector"), llvm::cl::cat(dumperCategory));
+
+static llvm::cl::opt<std::string> cacheDirectory(
+    "dump-ast-cache",
+    llvm::cl::desc("Serve unchanged files from, and store new dumps in, "
+                   "this directory"),
+    llvm::cl::value_desc("dir"), llvm::cl::cat(dumperCategory));
+
+static llvm::cl::opt<unsigned> cacheSize(
+    "dump-ast-cache-size",
+    llvm::cl::desc("Size of the cache in MiB, beyond which the least "
+                   "recently used dumps are removed"),
+    llvm::cl::init(1024), llvm::cl::cat(dumperCategory));
+
+static llvm::cl::opt<Compression> compression(
+    "dump-ast-compress", llvm::cl::desc("Compression of the output"),
+    llvm::cl::values(
+        clEnumValN(Compression::None, "none", "Uncompressed (default)"),
+        clEnumValN(Compression::Zlib, "zlib", "gzip format"),
+        clEnumValN(Compression::Zstd, "zstd",
+                   "zstd, or zlib if the plugin is built without it")),
+    llvm::cl::init(Compression::None), llvm::cl::cat(dumperCategory));
+
+static llvm::cl::opt<int> compressionLevel(
+    "dump-ast-compress-level",
+    llvm::cl::desc("Compression level, 0 for the default of the codec"),
+    llvm::cl::init(0), llvm::cl::cat(dumperCategory));
+
+static llvm::cl::opt<unsigned> compressionThreads(
+    "dump-ast-compress-threads",
+    llvm::cl::desc("Worker threads of the zstd compression, 0 to compress "
+                   "on the calling thread"),
+    llvm::cl::init(0), llvm::cl::cat(dumperCategory));
+
+static llvm::cl::opt<std::string> hashIndexPath(
+    "dump-ast-hash-index",
+    llvm::cl::desc("Write the structural hashes of the dumped nodes to this "
+                   "file, to diff a later dump against"),
+    llvm::cl::value_desc("path"), llvm::cl::cat(dumperCategory));
+
+static llvm::cl::opt<std::string> diffBase(
+    "dump-ast-diff",
+    llvm::cl::desc("Write the nodes deleted, modified and inserted since this "
+                   "hash index or binary dump with extents, instead of the "
+                   "dump"),
+    llvm::cl::value_desc("path"), llvm::cl::cat(dumperCategory));
+
+static llvm::cl::opt<std::string> shardPrefix(
+    "dump-ast-shards",
+    llvm::cl::desc("Write the JSON dump in shards <prefix>.<n>.ndjson, with "
+                   "an index of the nodes and program units in "
+                   "<prefix>.index"),
+    llvm::cl::value_desc("prefix"), llvm::cl::cat(dumperCategory));
+
+static llvm::cl::opt<unsigned> shardSize(
+    "dump-ast-shard-size",
+    llvm::cl::desc("Cut the shards by size, in MiB, instead of before each "
+                   "program unit"),
+    llvm::cl::init(0), llvm::cl::cat(dumperCategory));
+
+DumpOptions DumpOptions::fromCommandLine() {
+  DumpOptions options;
+  options.ids = idMode;
+  options.source = sourceMode;
+  options.layout = jsonLayout;
+  options.enums = enumMode;
+  options.encoding = propertyEncoding;
+  options.output = outputPath;
+  options.profile = profilePath;
+  options.threads = dumpThreads;
+  options.extents = nodeExtents;
+  options.dag = dagOutput;
+  options.select = selectText;
+  options.cache = cacheDirectory;
+  options.cacheSize = std::uint64_t(::cacheSize) << 20;
+  options.compression = ::compression;
+  options.compressionLevel = ::compressionLevel;
+  options.compressionThreads = ::compressionThreads;
+  options.hashIndex = hashIndexPath;
+  options.diff = diffBase;
+  options.shards = shardPrefix;
+  options.shardSize = std::uint64_t(::shardSize) << 20;
+  return options;
+}
+
+template <typename T>
+static llvm::Error setValue(T &option, std::optional<T> value,
+                            llvm::StringRef name, llvm::StringRef text) {
+  if (!value)
+    return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                   "invalid value '%s' for dump-ast-%s",
+                                   text.str().c_str(), name.str().c_str());
+  option = *value;
+  return llvm::Error::success();
+}
+
+template <typename T>
+static std::optional<T> parseInteger(llvm::StringRef text) {
+  T value;
+  if (text.getAsInteger(10, value))
+    return std::nullopt;
+  return value;
+}
+
+static std::optional<bool> parseBool(llvm::StringRef text) {
+  return llvm::StringSwitch<std::optional<bool>>(text)
+      .Case("true", true)
+      .Case("1", true)
+      .Case("false", false)
+      .Case("0", false)
+      .Default(std::nullopt);
+}
+
+llvm::Error DumpOptions::set(llvm::StringRef name, llvm::StringRef value) {
+  if (name == "ids")
+    return setValue(ids,
+                    llvm::StringSwitch<std::optional<IdMode>>(value)
+                        .Case("address", IdMode::Address)
+                        .Case("compact", IdMode::Compact)
+                        .Default(std::nullopt),
+                    name, value);
+  if (name == "source")
+    return setValue(source,
+                    llvm::StringSwitch<std::optional<SourceMode>>(value)
+                        .Case("text", SourceMode::Text)
+                        .Case("ranges", SourceMode::Ranges)
+                        .Case("positions", SourceMode::Positions)
+                        .Default(std::nullopt),
+                    name, value);
+  if (name == "layout")
+    return setValue(layout,
+                    llvm::StringSwitch<std::optional<JsonLayout>>(value)
+                        .Case("document", JsonLayout::Document)
+                        .Case("ndjson", JsonLayout::Lines)
+                        .Default(std::nullopt),
+                    name, value);
+  if (name == "enums")
+    return setValue(enums,
+                    llvm::StringSwitch<std::optional<EnumMode>>(value)
+                        .Case("inline", EnumMode::Inline)
+                        .Case("reference", EnumMode::Reference)
+                        .Default(std::nullopt),
+                    name, value);
+  if (name == "encoding")
+    return setValue(encoding,
+                    llvm::StringSwitch<std::optional<PropertyEncoding>>(value)
+                        .Case("named", PropertyEncoding::Named)
+                        .Case("positional", PropertyEncoding::Positional)
+                        .Default(std::nullopt),
+                    name, value);
+  if (name == "threads")
+    return setValue(threads, parseInteger<unsigned>(value), name, value);
+  if (name == "extents")
+    return setValue(extents, parseBool(value), name, value);
+  if (name == "dag")
+    return setValue(dag, parseBool(value), name, value);
+  if (name == "select") {
+    // Checked here, so that a bad selector is rejected with its request. An
+    // empty one selects everything.
+    if (!value.empty())
+      if (auto selector = Selector::parse(value); !selector)
+        return selector.takeError();
+    select = value.str();
+    return llvm::Error::success();
+  }
+  if (name == "compress")
+    return setValue(compression,
+                    llvm::StringSwitch<std::optional<Compression>>(value)
+                        .Case("none", Compression::None)
+                        .Case("zlib", Compression::Zlib)
+                        .Case("zstd", Compression::Zstd)
+                        .Default(std::nullopt),
+                    name, value);
+  if (name == "compress-level")
+    return setValue(compressionLevel, parseInteger<int>(value), name, value);
+  if (name == "compress-threads")
+    return setValue(compressionThreads, parseInteger<unsigned>(value), name,
+                    value);
+  bool host = name == "output" || name == "profile" || name == "cache" ||
+              name == "cache-size" || name == "hash-index" || name == "diff" ||
+              name == "shards" || name == "shard-size";
+  return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                 host ? "dump-ast-%s cannot be set here"
+                                      : "unknown option dump-ast-%s",
+                                 name.str().c_str());
+}
@@ -0,0 +1,96 @@
+#ifndef __OPTIONS_H__
+#define __OPTIONS_H__
+
+#include <cstdint>
+#include <string>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+
+// === Dump options ===
+//
+// Options are registered as LLVM command line options, so they are passed to
+// the plugin with `-mllvm`, e.g. `-mllvm -dump-ast-ids=compact`.
+
+enum class IdMode {
+  Address, // "0x<address>-<NodeName>" strings
+  Compact, // Dense integers, assigned in order of first reference
+};
+
+enum class SourceMode {
+  Text,      // The source text of each node
+  Ranges,    // [offset, length] into the source of the file, written once
+  Positions, // File, line and column of the start and end in the original
+             // files, which are listed once
+};
+
+enum class JsonLayout {
+  Document, // A single object with an array of nodes, enums at the end
+  Lines,    // NDJSON: a header record with the enums, then one node per line
+};
+
+enum class PropertyEncoding {
+  Named,      // Objects with a key for every property
+  Positional, // Arrays of the values, keys given once by a layout table
+};
+
+enum class Compression {
+  None,
+  Zlib, // gzip format
+  Zstd,
+};
+
+enum class EnumMode {
+  Inline,    // The enums are written in every dump, with their schema hash
+  Reference, // Only the schema hash, the schema is written separately
+};
+
+struct DumpOptions {
+  IdMode ids = IdMode::Address;
+  SourceMode source = SourceMode::Text;
+  JsonLayout layout = JsonLayout::Document;
+  EnumMode enums = EnumMode::Inline;
+  PropertyEncoding encoding = PropertyEncoding::Named;
+  // File the plugin actions write to, instead of stdout, if not empty
+  std::string output;
+  // Where to write the per-node profile, if not empty. Needs a build with
+  // DUMP_AST_ENABLE_PROFILING.
+  std::string profile;
+  // Threads dumping the program units of a file, see
+  // NodeWriter::createFragment. 1 dumps on the calling thread.
+  unsigned threads = 1;
+  // Whether to write the extent of every node, see NodeExtent
+  bool extents = false;
+  // Whether identical subtrees are dumped once, see DagWriter
+  bool dag = false;
+  // Which part of the parse tree to dump, see Selector. Everything if empty.
+  std::string select;
+  // Directory of the dump cache, see DumpCache. No cache if empty.
+  std::string cache;
+  std::uint64_t cacheSize = std::uint64_t(1024) << 20; // In bytes
+  // Compression of the output, see CompressedStream
+  Compression compression = Compression::None;
+  int compressionLevel = 0; // 0 for the default of the codec
+  unsigned compressionThreads = 0;
+  // Where to write the structural hashes of the dump, see HashIndex. Not
+  // written if empty.
+  std::string hashIndex;
+  // Hash index or binary dump of a previous version of the file, to write the
+  // difference with instead of the dump, see writeTreeDiff. No diff if empty.
+  std::string diff;
+  // Prefix of the shards and of the index of a sharded JSON dump, see
+  // ShardWriter. Not sharded if empty.
+  std::string shards;
+  std::uint64_t shardSize = 0; // In bytes, 0 for a shard per program unit
+
+  // Options given on the command line
+  static DumpOptions fromCommandLine();
+
+  // Sets the option that has this name on the command line, without its
+  // "dump-ast-" prefix, e.g. set("ids", "compact"). The options naming files
+  // of the host, output, profile, cache, hash-index, diff and shards, cannot
+  // be set this way.
+  llvm::Error set(llvm::StringRef name, llvm::StringRef value);
+};
+
+#endif // __OPTIONS_H__
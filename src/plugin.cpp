@@ -1,23 +1,42 @@
-#include <sstream>
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <type_traits>
-#include <iomanip>
+#include <vector>
 
+#include <llvm/Support/MemoryBuffer.h>
 #include <llvm/Support/raw_ostream.h>
 
+#include "clang/Basic/Diagnostic.h"
 #include "flang/Support/Fortran.h"
+#include "flang/Frontend/CompilerInstance.h"
 #include "flang/Frontend/FrontendActions.h"
 #include "flang/Frontend/FrontendPluginRegistry.h"
 #include "flang/Parser/dump-parse-tree.h"
 #include "flang/Parser/parse-tree.h"
 #include "flang/Parser/parsing.h"
 
+#include "binary_reader.h"
+#include "binary_writer.h"
+#include "compressed_stream.h"
+#include "dag_writer.h"
+#include "dump_ast.h"
+#include "dump_cache.h"
+#include "extents.h"
+#include "json_writer.h"
+#include "line_map.h"
+#include "mapped_file_stream.h"
+#include "null_writer.h"
 #include "plugin.h"
-
-template <typename T, template <typename...> class Template>
-struct is_specialization : std::false_type {};
-
-template <typename... Args, template <typename...> class Template>
-struct is_specialization<Template<Args...>, Template> : std::true_type {};
+#include "profiler.h"
+#include "selection.h"
+#include "shard_writer.h"
+#include "structural_hash.h"
+#include "symbols.h"
+#include "thread_pool.h"
+#include "tree_diff.h"
 
 template <typename T> struct is_indirection : std::false_type {};
 
@@ -25,37 +44,11 @@ template <typename T, bool COPY>
 struct is_indirection<Fortran::common::Indirection<T, COPY>> : std::true_type {
 };
 
-template <typename T> const char *getNodeName(const T &v) {
-  if constexpr (is_specialization<T, Fortran::parser::Statement>::value) {
-    return "Statement";
-  } else if constexpr (is_specialization<
-                           T, Fortran::parser::UnlabeledStatement>::value) {
-    return "UnlabeledStatement";
-  } else if constexpr (is_specialization<T, Fortran::parser::Scalar>::value
-                    || is_specialization<T, Fortran::parser::Constant>::value
-                    || is_specialization<T, Fortran::parser::Integer>::value
-                    || is_specialization<T, Fortran::parser::Logical>::value) {
-    return "Expr";
-  } else if constexpr (is_specialization<T,
-                                         Fortran::parser::DefaultChar>::value) {
-    return "DefaultChar";
-  } else if constexpr (std::is_same_v<T, Fortran::parser::CharBlock>) {
-    return "CharBlock";
-  } else {
-    if constexpr (std::is_same_v<
-                      decltype(Fortran::parser::ParseTreeDumper::GetNodeName(
-                          v)),
-                      std::string>) {
-      static std::string name =
-          Fortran::parser::ParseTreeDumper::GetNodeName(v);
-      return name.c_str();
-    } else {
-      return Fortran::parser::ParseTreeDumper::GetNodeName(v);
-    }
-  }
+template <typename T> std::string_view getNodeName(const T &) {
+  return NodeTraits<T>::name;
 }
 
-template <typename T> const char *getNodeName(const std::optional<T> &v) {
+template <typename T> std::string_view getNodeName(const std::optional<T> &v) {
   if (v.has_value()) {
     return getNodeName(v.value());
   } else {
@@ -64,11 +57,11 @@ template <typename T> const char *getNodeName(const std::optional<T> &v) {
 }
 
 template <typename T>
-const char *getNodeName(const Fortran::common::Indirection<T> &v) {
+std::string_view getNodeName(const Fortran::common::Indirection<T> &v) {
   return getNodeName(v.value());
 }
 
-template <typename T> const char *getNodeName(const std::list<T> &v) {
+template <typename T> std::string_view getNodeName(const std::list<T> &v) {
   if (v.empty()) {
     return "list";
   } else {
@@ -76,233 +69,263 @@ template <typename T> const char *getNodeName(const std::list<T> &v) {
   }
 }
 
-template <typename T> std::string &getId(const T &v, const char *name) {
-  std::ostringstream oss;
-  oss << "0x" << std::hex << reinterpret_cast<uintptr_t>(&v) << "-" << name;
-  static std::string id;
-  id = oss.str();
-  return id;
-}
-
-template <typename T> std::string getId(const T &v) {
-  return getId(v, getNodeName(v));
+template <typename T> void dumpId(NodeWriter &out, const T &v) {
+  out.id(&v, getNodeName(v));
 }
 
-template <typename T> std::string getId(const std::optional<T> &v) {
+template <typename T>
+void dumpId(NodeWriter &out, const std::optional<T> &v) {
   if (v.has_value()) {
-    return getId(v.value());
+    dumpId(out, v.value());
   } else {
-    return getId(std::nullopt);
+    dumpId(out, std::nullopt);
   }
 }
 
 template <typename T>
-std::string getId(const Fortran::common::Indirection<T> &v) {
-  return getId(v.value());
+void dumpId(NodeWriter &out, const Fortran::common::Indirection<T> &v) {
+  dumpId(out, v.value());
 }
 
-template <> std::string getId(const std::nullopt_t &) { return "null"; }
+template <> void dumpId(NodeWriter &out, const std::nullopt_t &) {
+  out.nullId();
+}
 
 struct variant_visitor {
+  NodeWriter &out;
+
   template <typename T> void operator()(const T &value) const {
-    const char *valueName = getNodeName(value);
+    std::string_view valueName = getNodeName(value);
 
-    dump(valueName, "variantKey");
-    dump(value, valueName);
+    dump(out, valueName, "variantKey");
+    dump(out, value, valueName);
   }
 };
 
-template <typename T> void dump(const T &v, const char *property_name) {
-  DUMP_PROPERTY(property_name, getId(v));
+template <typename T>
+void dump(NodeWriter &out, const T &v, std::string_view property_name) {
+  out.key(property_name);
+  dumpId(out, v);
 }
 
-void dump(const char *v, const char *property_name) {
-  dump(v ? std::string_view{v} : std::string_view{}, property_name);
+void dump(NodeWriter &out, const char *v, std::string_view property_name) {
+  dump(out, v ? std::string_view{v} : std::string_view{}, property_name);
 }
 
-void dump(const bool v, const char *property_name) {
+void dump(NodeWriter &out, const bool v, std::string_view property_name) {
     DUMP_PROPERTY(property_name, v);
 }
 
-void dump(std::string_view v, const char *property_name) {
-  DUMP_PROPERTY(property_name, escape_quotes(v));
-}
-
-std::string escape_quotes(std::string_view sv) {
-    std::string out;
-    out.reserve(sv.size());
-
-    for (char c : sv) {
-        if (c == '"')
-            out += "\\\"";
-        else
-            out += c;
-    }
-    return out;
+void dump(NodeWriter &out, std::string_view v,
+          std::string_view property_name) {
+  DUMP_PROPERTY(property_name, v);
 }
 
 template <typename T>
-void dump(const Fortran::parser::Scalar<T> &v, const char *property_name) {
-    dump(v.thing, property_name);
+void dump(NodeWriter &out, const Fortran::parser::Scalar<T> &v,
+          std::string_view property_name) {
+    dump(out, v.thing, property_name);
 }
 
 template <typename T>
-void dump(const Fortran::parser::Logical<T> &v, const char *property_name) {
-    dump(v.thing, property_name);
+void dump(NodeWriter &out, const Fortran::parser::Logical<T> &v,
+          std::string_view property_name) {
+    dump(out, v.thing, property_name);
 }
 
 template <typename T>
-void dump(const Fortran::parser::Integer<T> &v, const char *property_name) {
-    dump(v.thing, property_name);
+void dump(NodeWriter &out, const Fortran::parser::Integer<T> &v,
+          std::string_view property_name) {
+    dump(out, v.thing, property_name);
 }
 
 template <typename T>
-void dump(const Fortran::parser::Constant<T> &v, const char *property_name) {
-    dump(v.thing, property_name);
+void dump(NodeWriter &out, const Fortran::parser::Constant<T> &v,
+          std::string_view property_name) {
+    dump(out, v.thing, property_name);
 }
 
 template <typename T>
-void dump(const Fortran::parser::DefaultChar<T> &v, const char *property_name) {
-  dump(v.thing, property_name);
+void dump(NodeWriter &out, const Fortran::parser::DefaultChar<T> &v,
+          std::string_view property_name) {
+  dump(out, v.thing, property_name);
 }
 
-void dump(const Fortran::parser::Sign &v, const char *property_name) {
+void dump(NodeWriter &out, const Fortran::parser::Sign &v,
+          std::string_view property_name) {
     switch(v) {
         case Fortran::parser::Sign::Positive:
-            dump("positive", property_name);
+            dump(out, "positive", property_name);
             break;
         case Fortran::parser::Sign::Negative:
-            dump("negative", property_name);
+            dump(out, "negative", property_name);
             break;
     }
 }
 
-template <> void dump(const std::uint64_t &v, const char *property_name) {
+template <>
+void dump(NodeWriter &out, const std::uint64_t &v,
+          std::string_view property_name) {
   DUMP_PROPERTY(property_name, v);
 }
 
-template <> void dump(const int &v, const char *property_name) {
+template <>
+void dump(NodeWriter &out, const int &v, std::string_view property_name) {
   DUMP_PROPERTY(property_name, v);
 }
 
-template <> void dump(const std::string &v, const char *property_name) {
-  dump(std::string_view{v}, property_name);
+template <>
+void dump(NodeWriter &out, const std::string &v,
+          std::string_view property_name) {
+  dump(out, std::string_view{v}, property_name);
 }
 
 template <>
-void dump(const Fortran::parser::CharBlock &v, const char *property_name) {
-  dump(v.ToString(), property_name);
+void dump(NodeWriter &out, const Fortran::parser::CharBlock &v,
+          std::string_view property_name) {
+  out.key(property_name);
+  out.source(std::string_view{v.begin(), v.size()});
 }
 
-template <> void dump(const std::nullopt_t &v, const char *property_name) {
+template <>
+void dump(NodeWriter &out, const std::nullopt_t &v,
+          std::string_view property_name) {
   // No need to dump anything
 }
 
 template <typename T>
-void dump(const std::list<T> &v, const char *property_name) {
-  if (!strcmp(property_name, "list")) {
+void dump(NodeWriter &out, const std::list<T> &v,
+          std::string_view property_name) {
+  if (property_name == "list") {
     return;
   }
-  bool first = true;
 
-  llvm::outs() << ",\n\"" << property_name << "\": [\n";
+  out.key(property_name);
+  out.beginArray();
   for (const auto &item : v) {
-    if (!first) {
-      llvm::outs() << ",\n";
-    } else {
-      first = false;
-    }
-    llvm::outs() << "\"" << getId(item) << "\"";
+    out.element();
+    dumpId(out, item);
   }
-  llvm::outs() << "]";
+  out.endArray();
 }
 
 template <typename T>
-void dump(const Fortran::parser::Statement<T> &v, const char *property_name) {
-  DUMP_PROPERTY(property_name << "<" << getNodeName(v.statement) << ">",
-                getId(v));
+void dump(NodeWriter &out, const Fortran::parser::Statement<T> &v,
+          std::string_view property_name) {
+  out.key(property_name, getNodeName(v.statement));
+  dumpId(out, v);
 }
 
-template <typename T> void dump(const Fortran::parser::Statement<T> &v) {
-  DUMP_PROPERTY(getNodeName(v) << "<" << getNodeName(v.statement) << ">",
-                getId(v));
+template <typename T>
+void dump(NodeWriter &out, const Fortran::parser::Statement<T> &v) {
+  out.key(getNodeName(v), getNodeName(v.statement));
+  dumpId(out, v);
 }
 
 template <typename T>
-void dump(const Fortran::parser::UnlabeledStatement<T> &v,
-          const char *property_name) {
-  DUMP_PROPERTY(property_name << "<" << getNodeName(v.statement) << ">",
-                getId(v));
+void dump(NodeWriter &out, const Fortran::parser::UnlabeledStatement<T> &v,
+          std::string_view property_name) {
+  out.key(property_name, getNodeName(v.statement));
+  dumpId(out, v);
 }
 
 template <typename T>
-void dump(const Fortran::parser::UnlabeledStatement<T> &v) {
-  DUMP_PROPERTY(getNodeName(v) << "<" << getNodeName(v.statement) << ">",
-                getId(v));
+void dump(NodeWriter &out, const Fortran::parser::UnlabeledStatement<T> &v) {
+  out.key(getNodeName(v), getNodeName(v.statement));
+  dumpId(out, v);
 }
 
 template <typename... T>
-void dump(const std::variant<T...> &v, const char *property_name) {
-  std::visit(variant_visitor{}, v);
+void dump(NodeWriter &out, const std::variant<T...> &v,
+          std::string_view property_name) {
+  std::visit(variant_visitor{out}, v);
 }
 
 template <typename T>
-void dump(const Fortran::common::Indirection<T> &v, const char *property_name) {
-  dump(v.value(), property_name);
+void dump(NodeWriter &out, const Fortran::common::Indirection<T> &v,
+          std::string_view property_name) {
+  dump(out, v.value(), property_name);
 }
 
 
 template <typename T>
-void dump(const Fortran::common::Indirection<T> &v) {
-  dump(v.value());
+void dump(NodeWriter &out, const Fortran::common::Indirection<T> &v) {
+  dump(out, v.value());
 }
 
 
-void dump(const Fortran::parser::Expr &v) {
-  dump(v.u);
+void dump(NodeWriter &out, const Fortran::parser::Expr &v) {
+  dump(out, v.u);
 }
 
 template <typename T>
-void dump(const std::optional<T> &v, const char *property_name) {
+void dump(NodeWriter &out, const std::optional<T> &v,
+          std::string_view property_name) {
   if (v.has_value()) {
-    dump(v.value(), property_name);
+    dump(out, v.value(), property_name);
   } else {
-    dump(std::nullopt, property_name);
+    dump(out, std::nullopt, property_name);
   }
 }
 
 
 
-template <typename... T> void dump(const std::tuple<T...> &v) {
+template <typename... T>
+void dump(NodeWriter &out, const std::tuple<T...> &v) {
   // For each element in the tuple, call dump
-  std::apply([](const auto &...e) { ((dump(e, getNodeName(e))), ...); }, v);
+  std::apply(
+      [&out](const auto &...e) { ((dump(out, e, getNodeName(e))), ...); }, v);
 }
 
-// Visitor struct that defines Pre/Post functions for different types of nodes
-struct ParseTreeVisitor {
+// Visitor struct that defines Pre/Post functions for different types of nodes.
+// The dump of every node is measured by a Profiler, see profiler.h. With a
+// Selection, only the selected nodes are dumped and the rest is not walked.
+// With an ExtentRecorder, the extent of every dumped node is recorded.
+template <typename Profiler> struct ParseTreeVisitor {
 public:
   using ThisClass = ParseTreeVisitor;
-  bool firstNodeDump = true;
+  NodeWriter &out;
+  Profiler profiler;
+  Selection *selection = nullptr;
+  ExtentRecorder *extents = nullptr;
 
-  template <typename A> bool Pre(const A &) { return true; }
-  template <typename A> void Post(const A &) { return; }
+  explicit ParseTreeVisitor(NodeWriter &out) : out(out) {}
+
+  template <typename A> bool Pre(const A &v) {
+    return !selection || selection->enter(&v, getNodeName(v));
+  }
+
+  template <typename A> void Post(const A &v) {
+    if (selection)
+      selection->leave();
+    if (extents)
+      extents->leave(&v, getNodeName(v));
+  }
+
+  // Properties of the node being visited are written to this visitor's writer
+  template <typename... A> void dump(const A &...args) { ::dump(out, args...); }
 
   template <typename T> static void dump_enum() {
     // llvm::outs() << T::name() << ": " << T::value() << '\n';
   }
 
-  // Function to dump all registered enums as JSON
-  static void dumpEnumValues() {
-    const auto &reg = Collector<ThisClass>::get_registry();
-    bool first = true;
-    for (const auto &[name, func] : reg) {
-      if (!first)
-        llvm::outs() << ",\n";
-      llvm::outs() << "  \"" << name << "\": ";
-      func();
-      first = false;
-    }
-    llvm::outs() << "\n";
+  // Names of all the registered enums and their values, built once. Enums
+  // are registered by the constructor of the first visitor.
+  static const EnumSchema &schema() {
+    static const EnumSchema schema = [] {
+      const auto &reg = Collector<ThisClass>::get_registry();
+      std::vector<EnumEntry> entries;
+      entries.reserve(reg.size());
+      for (const auto &[name, size, enumerator] : reg) {
+        auto &entry = entries.emplace_back();
+        entry.name = name;
+        entry.values.reserve(size);
+        for (std::size_t i = 0; i < size; ++i)
+          entry.values.push_back(enumerator(i));
+      }
+      return EnumSchema(std::move(entries));
+    }();
+    return schema;
   }
 
   template <typename T> bool Pre(const Fortran::parser::Statement<T> &v) {
@@ -627,7 +650,7 @@ public:
     dump(lower_bound, "lower_bound");
     dump(upper_bound, "upper_bound");
   })
-  DUMP_NODE(Fortran::parser::Expr, {})
+  DUMP_NODE(Fortran::parser::Expr, { dumpType(out, v.typedExpr); })
   DUMP_NODE(Fortran::parser::Expr::Parentheses, {})
   DUMP_NODE(Fortran::parser::Expr::UnaryPlus, {})
   DUMP_NODE(Fortran::parser::Expr::Negate, {})
@@ -787,7 +810,10 @@ public:
   DUMP_NODE(Fortran::parser::ModuleSubprogramPart, {})
   DUMP_NODE(Fortran::parser::MpSubprogramStmt, {})
   DUMP_NODE(Fortran::parser::MsgVariable, {})
-  DUMP_NODE(Fortran::parser::Name, { dump(v.source, "source"); })
+  DUMP_NODE(Fortran::parser::Name, {
+    dump(v.source, "source");
+    dumpSymbol(out, v.symbol);
+  })
   DUMP_NODE(Fortran::parser::NamedConstant, {})
   DUMP_NODE(Fortran::parser::NamedConstantDef, {})
   DUMP_NODE(Fortran::parser::NamelistStmt, {})
@@ -1253,19 +1279,393 @@ public:
   })
 };
 
-class DumpAST : public Fortran::frontend::PluginParseTreeAction {
+// Dumps the program units of `program` concurrently, each into a fragment of
+// `out`, and appends the fragments in order as soon as they are done. Returns
+// false, having dumped nothing, if there is a single unit or `out` cannot be
+// split.
+template <typename Visitor>
+static bool walkUnitsInParallel(const Fortran::parser::Program &program,
+                                Visitor &visitor, NodeWriter &out,
+                                unsigned threads) {
+  std::vector<const Fortran::parser::ProgramUnit *> units;
+  for (const auto &unit : program.v)
+    units.push_back(&unit);
+  if (units.size() < 2)
+    return false;
+
+  std::vector<std::unique_ptr<NodeWriter>> fragments;
+  for (const auto *unit : units) {
+    auto fragment = out.createFragment(unit, getNodeName(*unit));
+    if (!fragment)
+      return false;
+    fragments.push_back(std::move(fragment));
+  }
+  std::vector<ExtentRecorder> extents(visitor.extents ? units.size() : 0);
+
+  std::mutex mutex;
+  std::condition_variable unitDone;
+  std::vector<bool> done(units.size());
+
+  ThreadPool pool(std::min<std::size_t>(threads, units.size()));
+  for (std::size_t i = 0; i < units.size(); ++i) {
+    pool.async([&, i] {
+      Visitor task(*fragments[i]);
+      if (visitor.extents)
+        task.extents = &extents[i];
+      Fortran::parser::Walk(*units[i], task);
+
+      std::lock_guard<std::mutex> lock(mutex);
+      done[i] = true;
+      unitDone.notify_all();
+    });
+  }
 
-  void executeAction() override {
-    llvm::outs() << "{\"nodes\": [\n";
-    ParseTreeVisitor visitor;
-    Fortran::parser::Walk(getParsing().parseTree(), visitor);
-    llvm::outs() << "],\n";
+  visitor.Pre(program);
+  for (std::size_t i = 0; i < units.size(); ++i) {
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      unitDone.wait(lock, [&] { return done[i]; });
+    }
+    if (visitor.extents)
+      visitor.extents->splice(extents[i]);
+    out.appendFragment(*fragments[i]);
+    fragments[i].reset();
+  }
+  visitor.Post(program);
+  pool.wait();
+  return true;
+}
 
-    llvm::outs() << "\"enums\": {\n";
-    ParseTreeVisitor::dumpEnumValues();
-    llvm::outs() << "}\n}\n";
+// Dumps the program units of `program` one after the other, each as a unit of
+// `shards`
+template <typename Visitor>
+static void walkUnitsInShards(const Fortran::parser::Program &program,
+                              Visitor &visitor, ShardWriter &shards) {
+  if (!visitor.Pre(program))
+    return;
+  for (const auto &unit : program.v) {
+    shards.beginUnit(programUnitName(unit).value_or(std::string_view{}));
+    Fortran::parser::Walk(unit, visitor);
+    shards.endUnit();
   }
-};
+  visitor.Post(program);
+}
+
+DumpAST::DumpAST() : DumpAST(llvm::outs(), DumpOptions::fromCommandLine()) {}
+
+DumpAST::DumpAST(llvm::raw_ostream &os, const DumpOptions &options)
+    : os(os), options(options) {
+  if (options.select.empty())
+    return;
+  auto parsed = Selector::parse(options.select);
+  if (parsed)
+    selector = std::move(*parsed);
+  else
+    selectorError = llvm::toString(parsed.takeError());
+}
+
+template <typename Visitor>
+void DumpAST::walk(Visitor &visitor, NodeWriter &out) {
+  // Built once for the file, for source positions and line terms
+  std::optional<LineMap> lineMap;
+  if (options.source == SourceMode::Positions || (selector && selector->lines))
+    lineMap.emplace(getParsing());
+
+  auto cooked = getParsing().cooked().AsCharBlock();
+  std::string file = getCurrentFileOrBufferName().str();
+  Document document{std::string_view{cooked.begin(), cooked.size()}, file,
+                    Visitor::schema()};
+  if (lineMap && options.source == SourceMode::Positions) {
+    document.files = lineMap->files();
+    document.locator = &*lineMap;
+  }
+  out.beginDocument(document);
+
+  const auto &program = getParsing().parseTree();
+  std::optional<Selection> selection;
+  if (selector && program) {
+    selection = Selection::plan(*selector, *program,
+                                lineMap ? &*lineMap : nullptr);
+    visitor.selection = &*selection;
+  }
+
+  // Structural hashes are combined along the extents
+  std::optional<ExtentRecorder> extents;
+  if (options.extents || hashing || dag)
+    visitor.extents = &extents.emplace();
+
+  // The profiler and the selection are not shared between threads
+  bool parallel = false;
+  if constexpr (std::is_same_v<Visitor, ParseTreeVisitor<NoProfiler>>)
+    parallel = program && !selection && options.threads > 1 &&
+               walkUnitsInParallel(*program, visitor, out, options.threads);
+  if (!parallel) {
+    if (sharding && program)
+      walkUnitsInShards(*program, visitor, *sharding);
+    else
+      Fortran::parser::Walk(program, visitor);
+  }
+  // Extents only cover the parse tree, which is dumped first
+  if (extents)
+    out.extents(extents->get());
+  dumpAfterParseTree(out);
+  out.endDocument();
+}
+
+void DumpAST::dumpParseTree(NodeWriter &out, IdMode ids, HashIndex *index) {
+  if (!selectorError.empty()) {
+    reportError(selectorError);
+    return;
+  }
+
+  hashing = index || !options.hashIndex.empty();
+  // The hashes and the diff refer to the nodes of the whole tree, and the
+  // shards to the units as they are walked
+  dag = options.dag && !hashing && !sharding;
+  if (dag && options.layout == JsonLayout::Lines)
+    llvm::errs() << "warning: -dump-ast-dag buffers the whole dump, the "
+                    "NDJSON lines are only written once the walk ends\n";
+  if (dag) {
+    DagWriter writer(out, options.extents);
+    walkParseTree(writer);
+    return;
+  }
+  if (!hashing) {
+    walkParseTree(out);
+    return;
+  }
+
+  // The hasher cannot be split, so the units are then dumped in order
+  StructuralHasher hasher(out, options.extents, ids);
+  walkParseTree(hasher);
+  if (!options.hashIndex.empty())
+    if (auto error = hasher.index().write(options.hashIndex))
+      reportError(llvm::toString(std::move(error)));
+  if (index)
+    *index = hasher.index();
+}
+
+void DumpAST::walkParseTree(NodeWriter &out) {
+  if (!options.profile.empty()) {
+#ifdef DUMP_AST_ENABLE_PROFILING
+    ParseTreeVisitor<NodeProfiler> visitor(out);
+    walk(visitor, out);
+    visitor.profiler.writeReport(options.profile);
+    return;
+#else
+    llvm::errs() << "warning: -dump-ast-profile needs a build with "
+                    "DUMP_AST_ENABLE_PROFILING, no profile is written\n";
+#endif
+  }
+
+  ParseTreeVisitor<NoProfiler> visitor(out);
+  walk(visitor, out);
+}
+
+void DumpAST::reportError(const llvm::Twine &message) {
+  auto &diags = getInstance().getDiagnostics();
+  unsigned id = diags.getCustomDiagID(clang::DiagnosticsEngine::Error, "%0");
+  diags.Report(id) << message.str();
+}
+
+void DumpAST::dumpTreeDiff() {
+  auto base = HashIndex::read(options.diff);
+  if (!base) {
+    reportError(llvm::toString(base.takeError()));
+    return;
+  }
+  // The diff refers to the old nodes by the ids of the index, which are only
+  // those of the old dump if it has compact ids
+  if (base->ids != IdMode::Compact) {
+    reportError(options.diff + ": the dump was not made with "
+                               "-dump-ast-ids=compact");
+    return;
+  }
+
+  // The new tree is dumped in the binary format, from which the nodes that
+  // changed are read back
+  std::string buffer;
+  HashIndex current;
+  {
+    llvm::raw_string_ostream stream(buffer);
+    BinaryWriter out(stream, options);
+    dumpParseTree(out, IdMode::Compact, &current);
+  }
+  if (buffer.empty())
+    return;
+  auto tree = BinaryAst::fromBuffer(llvm::MemoryBuffer::getMemBuffer(
+      buffer, getCurrentFileOrBufferName(), /*RequiresNullTerminator=*/false));
+  if (!tree) {
+    reportError(llvm::toString(tree.takeError()));
+    return;
+  }
+
+  writeOutput([&](llvm::raw_ostream &output) {
+    if (auto error =
+            writeCompressed(output, options, [&](llvm::raw_ostream &os) {
+              writeTreeDiff(os, *tree, current, *base, options,
+                            enumSchema().hash());
+            }))
+      reportError(llvm::toString(std::move(error)));
+  });
+}
+
+void DumpAST::dumpShards() {
+  // The index gives the lines of the nodes by their compact id
+  DumpOptions shardOptions = options;
+  shardOptions.ids = IdMode::Compact;
+  shardOptions.layout = JsonLayout::Lines;
+  shardOptions.encoding = PropertyEncoding::Named;
+
+  ShardStream stream(options.shards);
+  JsonWriter json(stream, shardOptions);
+  ShardWriter out(json, stream, options.shardSize);
+  sharding = &out;
+  dumpParseTree(out, shardOptions.ids);
+  sharding = nullptr;
+  json.flush();
+
+  if (auto ec = stream.close()) {
+    reportError("cannot write the shards of " + options.shards + ": " +
+                ec.message());
+    return;
+  }
+  if (auto error = out.index().write(options.shards + ".index"))
+    reportError(llvm::toString(std::move(error)));
+}
+
+void DumpAST::writeOutput(
+    llvm::function_ref<void(llvm::raw_ostream &)> write) {
+  if (options.output.empty()) {
+    write(os);
+    return;
+  }
+
+  std::error_code ec;
+  auto file = MappedFileStream::create(options.output, ec);
+  if (!file) {
+    reportError("cannot open " + options.output + ": " + ec.message());
+    return;
+  }
+  write(*file);
+  if ((ec = file->close()))
+    reportError("cannot write " + options.output + ": " + ec.message());
+}
+
+void DumpAST::dumpThroughCache(
+    llvm::StringRef format, llvm::function_ref<void(llvm::raw_ostream &)> dump) {
+  writeOutput([&](llvm::raw_ostream &output) {
+    // Entries are stored compressed, so a hit is copied as it is
+    auto compressedDump = [&](llvm::raw_ostream &target) {
+      if (auto error = writeCompressed(target, options, dump)) {
+        reportError(llvm::toString(std::move(error)));
+        return false;
+      }
+      return true;
+    };
+
+    DumpCache *cache = DumpCache::get(options);
+    // A profile or a hash index needs the walk, and an invalid selector dumps
+    // nothing
+    if (!cache || !options.profile.empty() || !options.hashIndex.empty() ||
+        !selectorError.empty()) {
+      compressedDump(output);
+      return;
+    }
+
+    // Positions and line terms depend on more than the cooked source: a
+    // blank or comment line moves them without changing it
+    std::string provenance;
+    if (options.source == SourceMode::Positions || (selector && selector->lines))
+      provenance = LineMap(getParsing()).provenance();
+
+    auto cooked = getParsing().cooked().AsCharBlock();
+    std::string key = DumpCache::key(
+        std::string_view{cooked.begin(), cooked.size()},
+        getCurrentFileOrBufferName(), provenance, format, options);
+    if (cache->fetch(key, output))
+      return;
+
+    auto writer = cache->store(key, output);
+    if (!writer) {
+      compressedDump(output);
+      return;
+    }
+    if (compressedDump(*writer))
+      writer->commit();
+  });
+}
+
+void DumpAST::executeAction() {
+  if (!options.diff.empty()) {
+    dumpTreeDiff();
+    return;
+  }
+  if (!options.shards.empty()) {
+    dumpShards();
+    return;
+  }
+  dumpThroughCache("json", [this](llvm::raw_ostream &os) {
+    JsonWriter out(os, options);
+    dumpParseTree(out, options.ids);
+  });
+}
+
+void DumpASTBinary::executeAction() {
+  if (!options.diff.empty()) {
+    dumpTreeDiff();
+    return;
+  }
+  dumpThroughCache("binary", [this](llvm::raw_ostream &os) {
+    // Binary dumps always refer to nodes by their compact id
+    BinaryWriter out(os, options);
+    dumpParseTree(out, IdMode::Compact);
+  });
+}
+
+void DumpASTSemantics::executeAction() {
+  // Semantics reports its own errors
+  if (!runSemanticChecks())
+    return;
+  if (!options.diff.empty()) {
+    dumpTreeDiff();
+    return;
+  }
+  if (!options.shards.empty()) {
+    dumpShards();
+    return;
+  }
+  // Not cached: the dump also depends on the modules the file uses
+  writeOutput([this](llvm::raw_ostream &output) {
+    if (auto error =
+            writeCompressed(output, options, [this](llvm::raw_ostream &os) {
+              JsonWriter out(os, options);
+              dumpParseTree(out, options.ids);
+            }))
+      reportError(llvm::toString(std::move(error)));
+  });
+}
+
+void DumpASTSemantics::dumpAfterParseTree(NodeWriter &out) {
+  dumpSymbolTable(out, getInstance().getSemanticsContext().globalScope());
+}
+
+const EnumSchema &enumSchema() {
+  // Registers the enums
+  NullWriter out;
+  ParseTreeVisitor<NoProfiler> visitor(out);
+  return visitor.schema();
+}
+
+void dumpEnumSchema(llvm::raw_ostream &os) {
+  const auto &schema = enumSchema();
+  os << "{\"schema\": \"" << schema.hash() << "\", \"enums\": "
+     << schema.json() << "}\n";
+}
+
+void DumpASTSchema::executeAction() {
+  writeOutput([](llvm::raw_ostream &output) { dumpEnumSchema(output); });
+}
 
 class DumpParseTreeAction : public Fortran::frontend::PluginParseTreeAction {
 
@@ -1279,3 +1679,12 @@ const static Fortran::frontend::FrontendPluginRegistry::Add<DumpAST>
     X("dump-ast", "Dump all AST node data as a JSON object");
 const static Fortran::frontend::FrontendPluginRegistry::Add<DumpParseTreeAction>
     X2("dump-tree", "Run the ParseTreeDumper visitor on the code");
+const static Fortran::frontend::FrontendPluginRegistry::Add<DumpASTBinary>
+    X3("dump-ast-bin", "Dump all AST node data in the binary format");
+const static Fortran::frontend::FrontendPluginRegistry::Add<DumpASTSemantics>
+    X4("dump-ast-sema",
+       "Dump all AST node data as a JSON object, with the symbol table and "
+       "the types of expressions");
+const static Fortran::frontend::FrontendPluginRegistry::Add<DumpASTSchema>
+    X5("dump-ast-schema",
+       "Dump the enum schema referred to with -dump-ast-enums=reference");
@@ -3,116 +3,128 @@
 
 #include <optional>
 #include <string>
+#include <string_view>
 #include <variant>
 
 #include "flang/Common/indirection.h"
 #include "flang/Parser/parse-tree.h"
 
 #include "collector.h"
+#include "node_traits.h"
+#include "node_writer.h"
 
 template <typename T>
-const char *getNodeName(const T &v);
+std::string_view getNodeName(const T &v);
 template <typename T>
-const char *getNodeName(const std::optional<T> &v);
+std::string_view getNodeName(const std::optional<T> &v);
 template <typename T>
-const char *getNodeName(const Fortran::common::Indirection<T> &v);
+std::string_view getNodeName(const Fortran::common::Indirection<T> &v);
 template <typename T>
-const char *getNodeName(const std::list<T> &v);
+std::string_view getNodeName(const std::list<T> &v);
 
 template <typename T>
-std::string &getId(const T &v, const char *name);
+void dumpId(NodeWriter &out, const T &v);
 template <typename T>
-std::string getId(const T &v);
+void dumpId(NodeWriter &out, const std::optional<T> &v);
 template <typename T>
-std::string getId(const std::optional<T> &v);
-template <typename T>
-std::string getId(const Fortran::common::Indirection<T> &v);
+void dumpId(NodeWriter &out, const Fortran::common::Indirection<T> &v);
 template <>
-std::string getId(const std::nullopt_t &);
+void dumpId(NodeWriter &out, const std::nullopt_t &);
 
 template <typename T>
-void dump(const T &v, const char *property_name);
-void dump(const char *v, const char *property_name);
-std::string escape_cpp_string(const char *input);
+void dump(NodeWriter &out, const T &v, std::string_view property_name);
+void dump(NodeWriter &out, const char *v, std::string_view property_name);
 
-void dump(const bool v, const char *property_name);
-void dump(std::string_view v, const char *property_name);
-std::string escape_quotes(std::string_view sv);
+void dump(NodeWriter &out, const bool v, std::string_view property_name);
+void dump(NodeWriter &out, std::string_view v,
+          std::string_view property_name);
 
 template <>
-void dump(const std::uint64_t &v, const char *property_name);
+void dump(NodeWriter &out, const std::uint64_t &v,
+          std::string_view property_name);
 template <>
-void dump(const std::string &v, const char *property_name);
+void dump(NodeWriter &out, const std::string &v,
+          std::string_view property_name);
 template <>
-void dump(const Fortran::parser::CharBlock &v, const char *property_name);
+void dump(NodeWriter &out, const Fortran::parser::CharBlock &v,
+          std::string_view property_name);
 template <>
-void dump(const std::nullopt_t &v, const char *property_name);
+void dump(NodeWriter &out, const std::nullopt_t &v,
+          std::string_view property_name);
 template <typename T>
-void dump(const std::list<T> &v, const char *property_name);
+void dump(NodeWriter &out, const std::list<T> &v,
+          std::string_view property_name);
 template <typename T>
-void dump(const Fortran::parser::Statement<T> &v, const char *property_name);
+void dump(NodeWriter &out, const Fortran::parser::Statement<T> &v,
+          std::string_view property_name);
 template <typename T>
-void dump(const Fortran::parser::Statement<T> &v);
+void dump(NodeWriter &out, const Fortran::parser::Statement<T> &v);
 template <typename T>
-void dump(const Fortran::parser::UnlabeledStatement<T> &v,
-          const char *property_name);
+void dump(NodeWriter &out, const Fortran::parser::UnlabeledStatement<T> &v,
+          std::string_view property_name);
 template <typename T>
-void dump(const Fortran::parser::UnlabeledStatement<T> &v);
+void dump(NodeWriter &out, const Fortran::parser::UnlabeledStatement<T> &v);
 template <typename... T>
-void dump(const std::variant<T...> &v, const char *property_name = "value");
+void dump(NodeWriter &out, const std::variant<T...> &v,
+          std::string_view property_name = "value");
 template <typename T>
-void dump(const Fortran::common::Indirection<T> &v, const char *property_name);
+void dump(NodeWriter &out, const Fortran::common::Indirection<T> &v,
+          std::string_view property_name);
 template <typename T>
-void dump(const Fortran::common::Indirection<T> &v);
+void dump(NodeWriter &out, const Fortran::common::Indirection<T> &v);
 template <typename T>
-void dump(const std::optional<T> &v, const char *property_name);
+void dump(NodeWriter &out, const std::optional<T> &v,
+          std::string_view property_name);
 template <typename... T>
-void dump(const std::tuple<T...> &v);
-void dump(const Fortran::parser::Expr &v);
+void dump(NodeWriter &out, const std::tuple<T...> &v);
+void dump(NodeWriter &out, const Fortran::parser::Expr &v);
 template <typename T>
-void dump(const Fortran::parser::Scalar<T> &v, const char *property_name);
+void dump(NodeWriter &out, const Fortran::parser::Scalar<T> &v,
+          std::string_view property_name);
 template <typename T>
-void dump(const Fortran::parser::Logical<T> &v, const char *property_name);
+void dump(NodeWriter &out, const Fortran::parser::Logical<T> &v,
+          std::string_view property_name);
 template <typename T>
-void dump(const Fortran::parser::Integer<T> &v, const char *property_name);
+void dump(NodeWriter &out, const Fortran::parser::Integer<T> &v,
+          std::string_view property_name);
 template <typename T>
-void dump(const Fortran::parser::Constant<T> &v, const char *property_name);
+void dump(NodeWriter &out, const Fortran::parser::Constant<T> &v,
+          std::string_view property_name);
 template <typename T>
-void dump(const Fortran::parser::DefaultChar<T> &v, const char *property_name);
-void dump(const Fortran::parser::Sign &v, const char *property_name);
+void dump(NodeWriter &out, const Fortran::parser::DefaultChar<T> &v,
+          std::string_view property_name);
+void dump(NodeWriter &out, const Fortran::parser::Sign &v,
+          std::string_view property_name);
 
 
 template <typename T>
-void dumpWrapper(const T &v)
+void dumpWrapper(NodeWriter &out, const T &v)
 {
-  dump(v.v, getNodeName(v.v));
+  dump(out, v.v, getNodeName(v.v));
 }
 
 template <typename T>
-void dumpUnion(const T &v) { dump(v.u); }
+void dumpUnion(NodeWriter &out, const T &v) { dump(out, v.u); }
 
 template <typename T>
-void dumpTuple(const T &v) { dump(v.t); }
+void dumpTuple(NodeWriter &out, const T &v) { dump(out, v.t); }
 
 template <typename T>
-void dumpConstraint(const T &v) { dump(v.thing); }
+void dumpConstraint(NodeWriter &out, const T &v) { dump(out, v.thing); }
 
 #define DUMP_PROPERTY(KEY, VALUE) \
-  llvm::outs() << ",\n\"" << KEY << "\": \"" << VALUE << "\"";
-
-#define DUMP_BARE_NODE(CONTENT)                                 \
-  if (!firstNodeDump)                                           \
-  {                                                             \
-    llvm::outs() << ",\n";                                      \
-  }                                                             \
-  else                                                          \
-  {                                                             \
-    firstNodeDump = false;                                      \
-  }                                                             \
-  llvm::outs() << "{\n";                                        \
-  llvm::outs() << "\"" << "id" << "\": \"" << getId(v) << "\""; \
-  CONTENT;                                                      \
-  llvm::outs() << "\n}";                                        \
+  out.key(KEY);                   \
+  out.value(VALUE);
+
+#define DUMP_BARE_NODE(CONTENT)                                      \
+  if (selection && !selection->enter(&v, getNodeName(v)))            \
+    return false;                                                    \
+  if (extents)                                                       \
+    extents->enter(&v, getNodeName(v));                              \
+  [[maybe_unused]] auto scope = profiler.scope(getNodeName(v), out); \
+  out.beginNode(&v, getNodeName(v));                                 \
+  CONTENT;                                                           \
+  out.endNode();                                                     \
   return true;
 
 #define DUMP_NODE(CLASS, CONTENTS)                                  \
@@ -121,23 +133,24 @@ void dumpConstraint(const T &v) { dump(v.thing); }
     DUMP_BARE_NODE({                                                \
       if constexpr (UnionTrait<CLASS>)                              \
       {                                                             \
-        dumpUnion(v);                                               \
+        dumpUnion(out, v);                                          \
       }                                                             \
       else if constexpr (TupleTrait<CLASS>)                         \
       {                                                             \
-        dumpTuple(v);                                               \
+        dumpTuple(out, v);                                          \
       }                                                             \
       else if constexpr (WrapperTrait<CLASS>)                       \
       {                                                             \
-        dumpWrapper(v);                                             \
+        dumpWrapper(out, v);                                        \
       }                                                             \
       else if constexpr (ConstraintTrait<CLASS>)                    \
       {                                                             \
-        dumpConstraint(v);                                          \
+        dumpConstraint(out, v);                                     \
       }                                                             \
       else                                                          \
       {                                                             \
-        llvm::errs() << "Not implemented for " << getId(v) << "\n"; \
+        llvm::errs() << "Not implemented for " << &v << "-"          \
+                     << getNodeName(v) << "\n";                     \
       }                                                             \
                                                                     \
       CONTENTS;                                                     \
@@ -158,30 +171,20 @@ void dumpConstraint(const T &v) { dump(v.thing); }
 #define STRINGIFY_DETAIL(x) #x
 #define STRINGIFY(x) STRINGIFY_DETAIL(x)
 
-// Macro to register and dump enum values using ENUM_CLASS utilities
+// Macro to register and dump enum values using ENUM_CLASS utilities. Each enum
+// is registered once, when the first visitor is constructed.
 #define DUMP_ENUM_HELPER(Namespace, EnumType, EnumNumber)                   \
-  static void CONCATENATE(dump_, EnumNumber)()                              \
+  static std::string_view CONCATENATE(enum_name_, EnumNumber)(std::size_t i) \
   {                                                                         \
-    llvm::outs() << "[";                                                    \
-    for (std::size_t i = 0; i < Namespace::EnumType##_enumSize; ++i)        \
-    {                                                                       \
-      if (i > 0)                                                            \
-      {                                                                     \
-        llvm::outs() << ", ";                                               \
-      }                                                                     \
-      llvm::outs() << "\""                                                  \
-                   << Namespace::EnumToString(                              \
-                          static_cast<Namespace::EnumType>(i))              \
-                   << "\"";                                                 \
-    }                                                                       \
-    llvm::outs() << "]";                                                    \
+    return Namespace::EnumToString(static_cast<Namespace::EnumType>(i));    \
   }                                                                         \
   struct CONCATENATE(RegisterEnum_, EnumNumber)                             \
   {                                                                         \
     CONCATENATE(RegisterEnum_, EnumNumber)()                                \
     {                                                                       \
-      Collector<ThisClass>::Registrar reg{STRINGIFY(Namespace::EnumType),   \
-                                          &CONCATENATE(dump_, EnumNumber)}; \
+      static typename Collector<ThisClass>::Registrar reg{                  \
+          STRINGIFY(Namespace::EnumType), Namespace::EnumType##_enumSize,   \
+          &CONCATENATE(enum_name_, EnumNumber)};                            \
     }                                                                       \
   } CONCATENATE(registerEnum_, EnumNumber);                                 \
   DUMP_NODE(Namespace::EnumType, {                                          \
@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <vector>
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/JSON.h>
+
+#include "profiler.h"
+
+bool NodeProfiler::writeReport(llvm::StringRef path) const {
+  // Types may share a name, e.g. every Statement<T>
+  llvm::StringMap<Counters> merged;
+  for (const auto &entry : counters) {
+    const Counters &counter = entry.second;
+    auto &total = merged[counter.name];
+    total.name = counter.name;
+    total.visits += counter.visits;
+    total.bytes += counter.bytes;
+    total.time += counter.time;
+  }
+
+  std::vector<Counters> rows;
+  rows.reserve(merged.size());
+  for (const auto &entry : merged)
+    rows.push_back(entry.second);
+  std::sort(rows.begin(), rows.end(), [](const auto &a, const auto &b) {
+    return a.time != b.time ? a.time > b.time : a.name < b.name;
+  });
+
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec, llvm::sys::fs::OF_Text);
+  if (ec) {
+    llvm::errs() << path << ": " << ec.message() << "\n";
+    return false;
+  }
+
+  if (path.ends_with(".csv")) {
+    os << "node,visits,bytes,time_ns\n";
+    for (const auto &row : rows)
+      os << row.name << "," << row.visits << "," << row.bytes << ","
+         << row.time.count() << "\n";
+    return true;
+  }
+
+  llvm::json::OStream json(os, 2);
+  json.array([&] {
+    for (const auto &row : rows) {
+      json.object([&] {
+        json.attribute("node", llvm::StringRef(row.name));
+        json.attribute("visits", int64_t(row.visits));
+        json.attribute("bytes", int64_t(row.bytes));
+        json.attribute("time_ns", int64_t(row.time.count()));
+      });
+    }
+  });
+  os << "\n";
+  return true;
+}
@@ -0,0 +1,71 @@
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include <chrono>
+#include <cstdint>
+#include <string_view>
+
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "node_writer.h"
+
+// === Profiling policies ===
+//
+// ParseTreeVisitor opens a Scope of its Profiler around the dump of every
+// node. NoProfiler does nothing and compiles away; NodeProfiler counts, for
+// each node name, the visits, the bytes written and the time spent.
+
+class NoProfiler {
+public:
+  struct Scope {};
+
+  Scope scope(std::string_view, const NodeWriter &) { return {}; }
+};
+
+class NodeProfiler {
+public:
+  struct Counters {
+    std::string_view name;
+    std::uint64_t visits = 0;
+    std::uint64_t bytes = 0;
+    std::chrono::nanoseconds time{0};
+  };
+
+  class Scope {
+  public:
+    Scope(Counters &counters, const NodeWriter &out)
+        : counters(counters), out(out), bytes(out.bytesWritten()),
+          start(std::chrono::steady_clock::now()) {}
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+    ~Scope() {
+      counters.time += std::chrono::steady_clock::now() - start;
+      counters.bytes += out.bytesWritten() - bytes;
+      ++counters.visits;
+    }
+
+  private:
+    Counters &counters;
+    const NodeWriter &out;
+    std::uint64_t bytes;
+    std::chrono::steady_clock::time_point start;
+  };
+
+  // Names are NodeTraits names, so nodes of a type share the same pointer
+  Scope scope(std::string_view name, const NodeWriter &out) {
+    auto &entry = counters[name.data()];
+    entry.name = name;
+    return Scope(entry, out);
+  }
+
+  // Writes the counters, merged by name and sorted by decreasing time, as CSV
+  // if `path` ends with ".csv" and as JSON otherwise
+  bool writeReport(llvm::StringRef path) const;
+
+private:
+  llvm::DenseMap<const char *, Counters> counters;
+};
+
+#endif // __PROFILER_H__
@@ -0,0 +1,79 @@
+#ifndef __PROPERTY_LAYOUTS_H__
+#define __PROPERTY_LAYOUTS_H__
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+
+// === PropertyLayouts class ===
+//
+// Numbers the layouts of the dumped nodes, a layout being the name of a node
+// and the keys of its properties, in order. Layouts are found as the nodes are
+// dumped, since the keys of a variant or a statement depend on the
+// alternative it holds, and are numbered in order of first use.
+
+class PropertyLayouts {
+public:
+  struct Layout {
+    std::string name;
+    std::vector<std::string> keys;
+  };
+
+  // Layout of the next node, given by its name and then its keys
+  void begin(std::string_view name) {
+    signature.assign(name);
+    keyCount = 0;
+  }
+
+  void key(std::string_view name) {
+    signature += '\0';
+    signature += name;
+    ++keyCount;
+  }
+
+  void key(std::string_view name, std::string_view argument) {
+    signature += '\0';
+    signature += name;
+    signature += '<';
+    signature += argument;
+    signature += '>';
+    ++keyCount;
+  }
+
+  // Index of the layout of the node, and whether it is used for the first time
+  std::pair<std::uint32_t, bool> end() {
+    auto [it, inserted] = indices.try_emplace(signature, layouts.size());
+    if (inserted) {
+      auto &layout = layouts.emplace_back();
+      llvm::StringRef rest = signature;
+      std::tie(layout.name, rest) = splitField(rest);
+      layout.keys.reserve(keyCount);
+      for (std::size_t i = 0; i < keyCount; ++i) {
+        auto [key, next] = splitField(rest);
+        layout.keys.push_back(std::move(key));
+        rest = next;
+      }
+    }
+    return {it->second, inserted};
+  }
+
+  const std::vector<Layout> &get() const { return layouts; }
+
+private:
+  static std::pair<std::string, llvm::StringRef> splitField(llvm::StringRef s) {
+    auto [field, rest] = s.split('\0');
+    return {field.str(), rest};
+  }
+
+  llvm::StringMap<std::uint32_t> indices;
+  std::vector<Layout> layouts;
+  std::string signature; // Name and keys of the node, '\0' separated
+  std::size_t keyCount = 0;
+};
+
+#endif // __PROPERTY_LAYOUTS_H__
@@ -0,0 +1,240 @@
+#include <type_traits>
+#include <vector>
+
+#include <llvm/ADT/SmallVector.h>
+
+#include "flang/Parser/parse-tree-visitor.h"
+
+#include "line_map.h"
+#include "node_traits.h"
+#include "selection.h"
+
+namespace parser = Fortran::parser;
+
+namespace {
+
+llvm::Error invalid(const llvm::Twine &message) {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                 "invalid selector: " + message);
+}
+
+template <typename A, typename = void> struct HasSource : std::false_type {};
+
+template <typename A>
+struct HasSource<A, std::enable_if_t<std::is_same_v<
+                        std::decay_t<decltype(std::declval<const A &>().source)>,
+                        parser::CharBlock>>> : std::true_type {};
+
+// Name of the program units and subprograms that can be selected. Names are
+// lowercase in the cooked source.
+std::optional<std::string_view> unitName(const parser::Name &name) {
+  return std::string_view{name.source.begin(), name.source.size()};
+}
+
+std::optional<std::string_view> unitName(const parser::MainProgram &v) {
+  const auto &stmt =
+      std::get<std::optional<parser::Statement<parser::ProgramStmt>>>(v.t);
+  return stmt ? unitName(stmt->statement.v) : std::nullopt;
+}
+
+std::optional<std::string_view> unitName(const parser::FunctionSubprogram &v) {
+  return unitName(std::get<parser::Name>(
+      std::get<parser::Statement<parser::FunctionStmt>>(v.t).statement.t));
+}
+
+std::optional<std::string_view>
+unitName(const parser::SubroutineSubprogram &v) {
+  return unitName(std::get<parser::Name>(
+      std::get<parser::Statement<parser::SubroutineStmt>>(v.t).statement.t));
+}
+
+std::optional<std::string_view> unitName(const parser::Module &v) {
+  return unitName(
+      std::get<parser::Statement<parser::ModuleStmt>>(v.t).statement.v);
+}
+
+std::optional<std::string_view> unitName(const parser::Submodule &v) {
+  return unitName(std::get<parser::Name>(
+      std::get<parser::Statement<parser::SubmoduleStmt>>(v.t).statement.t));
+}
+
+std::optional<std::string_view> unitName(const parser::BlockData &v) {
+  const auto &name =
+      std::get<parser::Statement<parser::BlockDataStmt>>(v.t).statement.v;
+  return name ? unitName(*name) : std::nullopt;
+}
+
+std::optional<std::string_view>
+unitName(const parser::SeparateModuleSubprogram &v) {
+  return unitName(
+      std::get<parser::Statement<parser::MpSubprogramStmt>>(v.t).statement.v);
+}
+
+template <typename A>
+constexpr bool isUnit =
+    std::is_same_v<A, parser::MainProgram> ||
+    std::is_same_v<A, parser::FunctionSubprogram> ||
+    std::is_same_v<A, parser::SubroutineSubprogram> ||
+    std::is_same_v<A, parser::Module> || std::is_same_v<A, parser::Submodule> ||
+    std::is_same_v<A, parser::BlockData> ||
+    std::is_same_v<A, parser::SeparateModuleSubprogram>;
+
+// Parts of a unit that cannot contain another unit
+template <typename A>
+constexpr bool isUnitBody = std::is_same_v<A, parser::SpecificationPart> ||
+                            std::is_same_v<A, parser::ExecutionPart>;
+
+} // namespace
+
+llvm::Expected<Selector> Selector::parse(llvm::StringRef text) {
+  Selector selector;
+  llvm::SmallVector<llvm::StringRef, 4> terms;
+  text.split(terms, ',', -1, false);
+  if (terms.empty())
+    return invalid("no terms");
+
+  for (auto term : terms) {
+    auto [key, value] = term.trim().split('=');
+    if (value.empty())
+      return invalid("'" + term + "' is not <term>=<value>");
+
+    if (key == "unit") {
+      selector.units.insert(value.lower());
+    } else if (key == "kind") {
+      selector.kinds.insert(value);
+    } else if (key == "lines") {
+      auto [first, last] = value.split('-');
+      int a, b;
+      if (first.getAsInteger(10, a) ||
+          (last.empty() ? (b = a, false) : last.getAsInteger(10, b)) ||
+          a <= 0 || b < a)
+        return invalid("'" + value + "' is not a line range <a>-<b>");
+      if (selector.lines)
+        return invalid("more than one line range");
+      selector.lines = {a, b};
+    } else {
+      return invalid("unknown term '" + key + "'");
+    }
+  }
+  return selector;
+}
+
+// === SelectionPlanner class ===
+//
+// Visitor of the planning walk. Every node is pushed on a stack on entry, and
+// decided on exit, once the lines its subtree spans are known.
+
+class SelectionPlanner {
+public:
+  SelectionPlanner(const Selector &selector, const LineMap *lineMap,
+                   Selection &selection)
+      : selector(selector), lineMap(lineMap), selection(selection),
+        unitsOnly(selector.kinds.empty() && !selector.lines) {}
+
+  template <typename A> bool Pre(const A &v) {
+    Frame frame{{&v, NodeTraits<A>::name.data()}, NodeTraits<A>::name};
+
+    if constexpr (HasSource<A>::value) {
+      if (selector.lines) {
+        auto [first, last] = lineMap->lines(v.source);
+        // Nothing below can be within the lines
+        if (last < selector.lines->first || first > selector.lines->second)
+          return false;
+        frame.first = first;
+        frame.last = last;
+      }
+    }
+
+    if constexpr (isUnit<A>) {
+      if (!selector.units.empty()) {
+        auto name = unitName(v);
+        frame.unit = name && selector.units.contains(*name);
+      }
+    }
+    if constexpr (isUnitBody<A>) {
+      if (!selector.units.empty() && selectedUnits == 0)
+        return false;
+    }
+
+    if (frame.unit)
+      ++selectedUnits;
+    stack.push_back(frame);
+    return true;
+  }
+
+  template <typename A> void Post(const A &) {
+    Frame frame = stack.back();
+    stack.pop_back();
+
+    if (matches(frame)) {
+      selection.roots.insert(frame.key);
+      // Frames below a marked one are already marked
+      for (auto it = stack.rbegin(); it != stack.rend() && !it->marked; ++it) {
+        selection.ancestors.insert(it->key);
+        it->marked = true;
+      }
+    }
+
+    if (frame.unit)
+      --selectedUnits;
+    if (!stack.empty() && frame.first > 0) {
+      auto &parent = stack.back();
+      parent.first = parent.first > 0 ? std::min(parent.first, frame.first)
+                                      : frame.first;
+      parent.last = std::max(parent.last, frame.last);
+    }
+  }
+
+private:
+  struct Frame {
+    Selection::Key key;
+    std::string_view name;
+    int first = 0; // Lines spanned by the subtree, 0 if unknown
+    int last = 0;
+    bool unit = false;   // A selected unit
+    bool marked = false; // Already marked as an ancestor
+  };
+
+  bool matches(const Frame &frame) const {
+    if (unitsOnly)
+      return frame.unit;
+    if (!selector.units.empty() && selectedUnits == 0)
+      return false;
+    if (!selector.kinds.empty() && !selector.kinds.contains(frame.name))
+      return false;
+    if (selector.lines && (frame.first == 0 ||
+                           frame.first < selector.lines->first ||
+                           frame.last > selector.lines->second))
+      return false;
+    return true;
+  }
+
+  const Selector &selector;
+  const LineMap *lineMap;
+  Selection &selection;
+  bool unitsOnly;
+  std::vector<Frame> stack;
+  unsigned selectedUnits = 0; // Selected units on the stack
+};
+
+Selection Selection::plan(const Selector &selector,
+                          const parser::Program &program,
+                          const LineMap *lineMap) {
+  Selection selection;
+  SelectionPlanner planner(selector, lineMap, selection);
+  parser::Walk(program, planner);
+  return selection;
+}
+
+std::optional<std::string_view>
+programUnitName(const parser::ProgramUnit &unit) {
+  return std::visit(
+      [](const auto &indirection) -> std::optional<std::string_view> {
+        using A = std::decay_t<decltype(indirection.value())>;
+        if constexpr (isUnit<A>)
+          return unitName(indirection.value());
+        else
+          return std::nullopt;
+      },
+      unit.u);
+}
@@ -0,0 +1,85 @@
+#ifndef __SELECTION_H__
+#define __SELECTION_H__
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Support/Error.h>
+
+#include "flang/Parser/parse-tree.h"
+
+class LineMap;
+
+// === Selector class ===
+//
+// Which parts of the parse tree to dump, given as comma-separated terms:
+//   unit=<name>     nodes inside the program unit or subprogram <name>
+//   kind=<Name>     nodes of that kind, as named in the dump
+//   lines=<a>-<b>   nodes whose source lies within lines a to b
+// Values of the same term are alternatives, different terms must all hold.
+// With only unit terms, the units themselves are selected.
+
+struct Selector {
+  llvm::StringSet<> units; // Lowercase, as names in the cooked source
+  llvm::StringSet<> kinds;
+  std::optional<std::pair<int, int>> lines;
+
+  static llvm::Expected<Selector> parse(llvm::StringRef text);
+};
+
+// Name of a program unit, as unit terms give it, or nullopt if it has none,
+// such as an unnamed main program or a compiler directive
+std::optional<std::string_view>
+programUnitName(const Fortran::parser::ProgramUnit &unit);
+
+// === Selection class ===
+//
+// Nodes selected in a parse tree: the roots of the selected subtrees and their
+// ancestors. ParseTreeVisitor asks it, on entering every node, whether to
+// dump it and its subtree.
+
+class Selection {
+public:
+  // Walks `program` once and finds the nodes selected by `selector`, pruning
+  // the subtrees that cannot match. `lineMap` is needed for line terms.
+  static Selection plan(const Selector &selector,
+                        const Fortran::parser::Program &program,
+                        const LineMap *lineMap);
+
+  // Whether to dump a node. Every call that returns true is followed by a
+  // call to leave once the subtree is walked.
+  bool enter(const void *node, std::string_view name) {
+    if (depth > 0) {
+      ++depth;
+      return true;
+    }
+    Key key{node, name.data()};
+    if (roots.contains(key)) {
+      depth = 1;
+      return true;
+    }
+    return ancestors.contains(key);
+  }
+
+  void leave() {
+    if (depth > 0)
+      --depth;
+  }
+
+private:
+  friend class SelectionPlanner;
+
+  // A node shares its address with its first member, so the name is part of
+  // the key. Names are NodeTraits names, compared by address.
+  using Key = std::pair<const void *, const char *>;
+
+  llvm::DenseSet<Key> roots;
+  llvm::DenseSet<Key> ancestors;
+  unsigned depth = 0; // Depth inside a selected subtree
+};
+
+#endif // __SELECTION_H__
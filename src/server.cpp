@@ -0,0 +1,371 @@
+#include <algorithm>
+#include <csignal>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/JSON.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/raw_socket_stream.h>
+
+#include "driver.h"
+#include "dump_ast.h"
+#include "options.h"
+
+// === dump-ast-server ===
+//
+// Keeps a frontend running and dumps files on request, so that clients such
+// as editors do not pay for starting flang and loading the plugin on every
+// dump. Requests are read from a Unix domain socket, one JSON object per line:
+//
+//   {"file": "a.f90", "format": "json", "options": {"select": "unit=m"}}
+//
+// "format" is "json" (default) or "binary". "options" sets dump options by
+// their command line name without the "dump-ast-" prefix, over the ones given
+// to the server, and "arguments" replaces its -Xflang arguments.
+//
+// Each response is a JSON line, {"status": "ok", "size": <n>, "parsed":
+// <bool>} followed by the <n> bytes of the dump, or {"status": "error",
+// "message": "..."}. A connection can send any number of requests.
+//
+// The parse trees of the most recently dumped files are kept in memory. A file
+// that has not changed since it was parsed with the same arguments, nor have
+// the files it includes, is dumped from its tree without running the frontend
+// again, whatever the options of the dump: a different selection only walks
+// the kept tree.
+//
+// A dump is rendered in memory before it is sent, since the response starts
+// with its size, so the peak memory of a request is about twice the size of
+// its dump.
+
+namespace cl = llvm::cl;
+
+static cl::OptionCategory serverCategory("dump-ast-server options");
+
+static cl::opt<std::string> socketPath(cl::Positional, cl::Required,
+                                       cl::desc("<socket>"),
+                                       cl::cat(serverCategory));
+
+static cl::opt<unsigned>
+    maxFiles("max-files", cl::desc("Number of parse trees kept in memory"),
+             cl::init(32), cl::cat(serverCategory));
+
+static cl::list<std::string>
+    flangArguments("Xflang", cl::desc("Pass an argument to flang -fc1"),
+                   cl::value_desc("arg"), cl::cat(serverCategory));
+
+namespace {
+
+llvm::Error requestError(const llvm::Twine &message) {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(), message);
+}
+
+// State of a file when it was parsed
+struct FileState {
+  std::string path;
+  llvm::sys::TimePoint<> modified;
+  std::uint64_t size;
+
+  bool unchanged() const {
+    llvm::sys::fs::file_status status;
+    return !llvm::sys::fs::status(path, status) &&
+           status.getLastModificationTime() == modified &&
+           status.getSize() == size;
+  }
+};
+
+// Parse tree of a file, and the state of the file and of the files it
+// includes when it was parsed
+struct Tree {
+  std::unique_ptr<ParsedFile> file;
+  llvm::sys::TimePoint<> modified;
+  std::uint64_t size;
+  std::vector<FileState> sources;
+  std::mutex mutex; // Runs on file must not overlap
+};
+
+// === TreeCache class ===
+//
+// Parse trees of the most recently dumped files, keyed by the path of the file
+// and the arguments it was parsed with. Trees are shared, so an evicted tree
+// lives until its last dump finishes.
+
+class TreeCache {
+public:
+  explicit TreeCache(std::size_t capacity) : capacity(capacity) {}
+
+  // Tree of `key`, if it was parsed from a file with this modification time
+  // and size, and the files it includes have not changed since
+  std::shared_ptr<Tree> find(const std::string &key,
+                             const llvm::sys::fs::file_status &status) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it == index.end())
+      return nullptr;
+
+    auto entry = it->second;
+    const Tree &tree = *entry->second;
+    if (tree.modified != status.getLastModificationTime() ||
+        tree.size != status.getSize() ||
+        !std::all_of(tree.sources.begin(), tree.sources.end(),
+                     [](const FileState &file) { return file.unchanged(); })) {
+      entries.erase(entry);
+      index.erase(it);
+      return nullptr;
+    }
+    entries.splice(entries.begin(), entries, entry);
+    return entry->second;
+  }
+
+  void insert(const std::string &key, std::shared_ptr<Tree> tree) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = index.find(key);
+    if (it != index.end()) {
+      entries.erase(it->second);
+      index.erase(it);
+    }
+    entries.emplace_front(key, std::move(tree));
+    index.emplace(key, entries.begin());
+
+    while (entries.size() > capacity) {
+      index.erase(entries.back().first);
+      entries.pop_back();
+    }
+  }
+
+private:
+  using Entry = std::pair<std::string, std::shared_ptr<Tree>>;
+
+  std::size_t capacity;
+  std::mutex mutex;
+  std::list<Entry> entries; // Most recently used first
+  std::unordered_map<std::string, std::list<Entry>::iterator> index;
+};
+
+struct Request {
+  std::string file;
+  bool binary = false;
+  DumpOptions options;
+  std::vector<std::string> arguments;
+};
+
+llvm::Expected<Request> parseRequest(llvm::StringRef line,
+                                     const DumpOptions &defaults) {
+  auto value = llvm::json::parse(line);
+  if (!value)
+    return value.takeError();
+  const auto *object = value->getAsObject();
+  if (!object)
+    return requestError("a request must be a JSON object");
+
+  Request request;
+  request.options = defaults;
+  request.arguments.assign(flangArguments.begin(), flangArguments.end());
+
+  auto file = object->getString("file");
+  if (!file)
+    return requestError("missing \"file\"");
+  request.file = file->str();
+
+  if (auto format = object->getString("format")) {
+    if (*format == "binary")
+      request.binary = true;
+    else if (*format != "json")
+      return requestError("unknown format '" + *format + "'");
+  }
+
+  if (const auto *options = object->getObject("options")) {
+    for (const auto &option : *options) {
+      llvm::StringRef name = option.first;
+      std::string text;
+      if (auto string = option.second.getAsString())
+        text = string->str();
+      else if (auto boolean = option.second.getAsBoolean())
+        text = *boolean ? "true" : "false";
+      else if (auto integer = option.second.getAsInteger())
+        text = std::to_string(*integer);
+      else
+        return requestError("invalid value for dump-ast-" + name);
+      if (auto error = request.options.set(name, text))
+        return std::move(error);
+    }
+  }
+
+  if (const auto *arguments = object->getArray("arguments")) {
+    request.arguments.clear();
+    for (const auto &argument : *arguments) {
+      auto string = argument.getAsString();
+      if (!string)
+        return requestError("\"arguments\" must be strings");
+      request.arguments.push_back(string->str());
+    }
+  }
+  return request;
+}
+
+// Dumps the file of `request` into `output`, from its kept tree if it has one.
+// `parsed` tells whether the file had to be parsed.
+llvm::Error dump(const Request &request, TreeCache &trees,
+                 std::string &output, bool &parsed) {
+  llvm::SmallString<256> path;
+  if (std::error_code ec = llvm::sys::fs::real_path(request.file, path))
+    return requestError(request.file + ": " + ec.message());
+  llvm::sys::fs::file_status status;
+  if (std::error_code ec = llvm::sys::fs::status(path, status))
+    return requestError(request.file + ": " + ec.message());
+
+  std::string key = path.str().str();
+  for (const auto &argument : request.arguments) {
+    key += '\0';
+    key += argument;
+  }
+
+  llvm::raw_string_ostream os(output);
+  std::unique_ptr<DumpAST> action;
+  if (request.binary)
+    action = std::make_unique<DumpASTBinary>(os, request.options);
+  else
+    action = std::make_unique<DumpAST>(os, request.options);
+
+  if (auto tree = trees.find(key, status)) {
+    parsed = false;
+    std::lock_guard<std::mutex> lock(tree->mutex);
+    if (!tree->file->run(*action))
+      return requestError(request.file + ": the dump failed");
+    return llvm::Error::success();
+  }
+
+  parsed = true;
+  auto file = ParsedFile::parse(*action, path, request.arguments);
+  if (!file)
+    return requestError(request.file + ": cannot be parsed");
+
+  auto tree = std::make_shared<Tree>();
+  tree->file = std::move(file);
+  tree->modified = status.getLastModificationTime();
+  tree->size = status.getSize();
+  // Taken after the parse, so a file changed during it may go unnoticed
+  for (auto &source : tree->file->sourceFiles()) {
+    llvm::sys::fs::file_status sourceStatus;
+    if (llvm::sys::fs::status(source, sourceStatus))
+      continue;
+    tree->sources.push_back({std::move(source),
+                             sourceStatus.getLastModificationTime(),
+                             sourceStatus.getSize()});
+  }
+  trees.insert(key, std::move(tree));
+  return llvm::Error::success();
+}
+
+void respond(llvm::raw_ostream &client, llvm::StringRef line,
+             TreeCache &trees, const DumpOptions &defaults) {
+  std::string output;
+  bool parsed = false;
+  llvm::Error error = [&]() -> llvm::Error {
+    auto request = parseRequest(line, defaults);
+    if (!request)
+      return request.takeError();
+    return dump(*request, trees, output, parsed);
+  }();
+
+  if (error) {
+    client << llvm::json::Value(llvm::json::Object{
+                  {"status", "error"},
+                  {"message", llvm::toString(std::move(error))}})
+           << "\n";
+  } else {
+    client << llvm::json::Value(llvm::json::Object{
+                  {"status", "ok"},
+                  {"size", static_cast<std::int64_t>(output.size())},
+                  {"parsed", parsed}})
+           << "\n"
+           << output;
+  }
+  client.flush();
+}
+
+// Answers the requests of a client until it disconnects
+void serve(std::unique_ptr<llvm::raw_socket_stream> client, TreeCache &trees,
+           const DumpOptions &defaults) {
+  std::string pending;
+  char buffer[4096];
+  while (!client->has_error()) {
+    auto newline = pending.find('\n');
+    if (newline == std::string::npos) {
+      auto count = client->read(buffer, sizeof(buffer));
+      if (count <= 0)
+        break;
+      pending.append(buffer, count);
+      continue;
+    }
+
+    std::string line = pending.substr(0, newline);
+    pending.erase(0, newline + 1);
+    if (!llvm::StringRef(line).trim().empty())
+      respond(*client, line, trees, defaults);
+  }
+  // A client that went away is not an error of the server
+  client->clear_error();
+}
+
+} // namespace
+
+int main(int argc, const char **argv) {
+  cl::ParseCommandLineOptions(
+      argc, argv, "Dumps the parse tree of Fortran files on request\n");
+
+  // Writing to a client that went away must not stop the server
+  std::signal(SIGPIPE, SIG_IGN);
+
+  DumpOptions defaults = DumpOptions::fromCommandLine();
+  // Dumps are sent to the clients
+  defaults.output.clear();
+  defaults.shards.clear();
+
+  // A socket left behind by a server that is no longer running is replaced
+  if (llvm::sys::fs::exists(socketPath)) {
+    auto other = llvm::raw_socket_stream::createConnectedUnix(socketPath);
+    if (other) {
+      llvm::errs() << socketPath << ": a server is already listening\n";
+      return 1;
+    }
+    llvm::consumeError(other.takeError());
+    llvm::sys::fs::remove(socketPath);
+  }
+
+  auto listener = llvm::ListeningSocket::createUnix(socketPath);
+  if (!listener) {
+    llvm::errs() << socketPath << ": " << llvm::toString(listener.takeError())
+                 << "\n";
+    return 1;
+  }
+
+  initializeFrontend();
+  TreeCache trees(maxFiles);
+
+  llvm::outs() << "Listening on " << socketPath << "\n";
+  llvm::outs().flush();
+
+  while (true) {
+    auto client = listener->accept();
+    if (!client) {
+      llvm::errs() << socketPath << ": " << llvm::toString(client.takeError())
+                   << "\n";
+      return 1;
+    }
+    std::thread(serve, std::move(*client), std::ref(trees),
+                std::cref(defaults))
+        .detach();
+  }
+}
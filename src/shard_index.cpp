@@ -0,0 +1,106 @@
+#include <cstring>
+
+#include <llvm/ADT/Twine.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "shard_index.h"
+
+namespace {
+
+constexpr char indexMagic[8] = {'F', 'D', 'A', 'S', 'T', 'S', 'I', 'X'};
+constexpr std::uint32_t indexVersion = 1;
+
+struct IndexHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t shardCount;
+  std::uint64_t nodeCount;
+  std::uint64_t unitCount;
+  std::uint64_t namesSize;
+};
+
+llvm::Error invalidIndex(llvm::StringRef path, const llvm::Twine &message) {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                 path + ": " + message);
+}
+
+} // namespace
+
+llvm::Error ShardIndex::write(llvm::StringRef path) const {
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec);
+  if (ec)
+    return llvm::createStringError(ec, "cannot open " + path + ": " +
+                                           ec.message());
+
+  IndexHeader header;
+  std::memcpy(header.magic, indexMagic, sizeof(indexMagic));
+  header.version = indexVersion;
+  header.shardCount = shardCount;
+  header.nodeCount = nodes.size();
+  header.unitCount = units.size();
+  header.namesSize = names.size();
+  os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  os.write(reinterpret_cast<const char *>(nodes.data()),
+           nodes.size() * sizeof(NodeLocation));
+  os.write(reinterpret_cast<const char *>(units.data()),
+           units.size() * sizeof(UnitRange));
+  os.write(names.data(), names.size());
+  os.close();
+  if (os.has_error()) {
+    ec = os.error();
+    os.clear_error();
+    return llvm::createStringError(ec, "cannot write " + path + ": " +
+                                           ec.message());
+  }
+  return llvm::Error::success();
+}
+
+llvm::Expected<ShardIndex> ShardIndex::read(llvm::StringRef path) {
+  auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/false,
+                                            /*RequiresNullTerminator=*/false);
+  if (!buffer)
+    return llvm::createStringError(buffer.getError(),
+                                   "cannot open " + path + ": " +
+                                       buffer.getError().message());
+  llvm::StringRef data = (*buffer)->getBuffer();
+
+  IndexHeader header;
+  if (data.size() < sizeof(header))
+    return invalidIndex(path, "not a shard index");
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (std::memcmp(header.magic, indexMagic, sizeof(indexMagic)) != 0)
+    return invalidIndex(path, "not a shard index");
+  if (header.version != indexVersion)
+    return invalidIndex(path, "unsupported shard index version " +
+                                  llvm::Twine(header.version));
+
+  std::uint64_t available = data.size() - sizeof(header);
+  if (header.nodeCount > available / sizeof(NodeLocation) ||
+      header.unitCount > (available - header.nodeCount * sizeof(NodeLocation)) /
+                             sizeof(UnitRange) ||
+      header.namesSize != available - header.nodeCount * sizeof(NodeLocation) -
+                              header.unitCount * sizeof(UnitRange))
+    return invalidIndex(path, "truncated shard index");
+
+  ShardIndex index;
+  index.shardCount = header.shardCount;
+  const char *p = data.data() + sizeof(header);
+  index.nodes.resize(header.nodeCount);
+  std::memcpy(index.nodes.data(), p, header.nodeCount * sizeof(NodeLocation));
+  p += header.nodeCount * sizeof(NodeLocation);
+  index.units.resize(header.unitCount);
+  std::memcpy(index.units.data(), p, header.unitCount * sizeof(UnitRange));
+  p += header.unitCount * sizeof(UnitRange);
+  index.names.assign(p, header.namesSize);
+
+  for (const auto &node : index.nodes)
+    if (node.shard != NodeLocation::none && node.shard >= index.shardCount)
+      return invalidIndex(path, "bad node location");
+  for (const auto &unit : index.units)
+    if (unit.shard >= index.shardCount || unit.endShard >= index.shardCount ||
+        std::uint64_t(unit.nameOffset) + unit.nameSize > index.names.size())
+      return invalidIndex(path, "bad unit range");
+  return index;
+}
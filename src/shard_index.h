@@ -0,0 +1,59 @@
+#ifndef __SHARD_INDEX_H__
+#define __SHARD_INDEX_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+
+// Where a node is in a sharded dump, at the index of its compact id. Nodes
+// that are only referenced, such as those left out by a selector, have shard
+// `none`.
+struct NodeLocation {
+  static constexpr std::uint32_t none = 0xffffffff;
+
+  std::uint64_t offset; // Of the line of the node in its shard
+  std::uint32_t shard;
+  std::uint32_t size; // Of the line, including its '\n'
+};
+
+// Nodes of a program unit, which are contiguous in the dump: from `offset` in
+// `shard` to `endOffset` in `endShard`. A unit only spans shards when they are
+// cut by size.
+struct UnitRange {
+  std::uint32_t nameOffset; // Into the names of the index
+  std::uint32_t nameSize;   // 0 for a unit without a name
+  std::uint32_t firstNode;  // Index of the first node in the order of the dump
+  std::uint32_t nodeCount;
+  std::uint32_t shard;
+  std::uint32_t endShard;
+  std::uint64_t offset;
+  std::uint64_t endOffset;
+};
+
+// === ShardIndex class ===
+//
+// Index of a dump written in shards with -dump-ast-shards, so that readers
+// can seek to a node or a program unit, or load the shards in parallel,
+// without reading the others. Files start with the magic "FDASTSIX", a
+// version, the number of shards, nodes and units and the size of the names,
+// followed by the NodeLocation of every compact id, the UnitRange of every
+// program unit in order, and the names of the units.
+
+struct ShardIndex {
+  std::uint32_t shardCount = 0;
+  std::vector<NodeLocation> nodes;
+  std::vector<UnitRange> units;
+  std::string names;
+
+  llvm::StringRef name(const UnitRange &unit) const {
+    return llvm::StringRef{names}.substr(unit.nameOffset, unit.nameSize);
+  }
+
+  llvm::Error write(llvm::StringRef path) const;
+  static llvm::Expected<ShardIndex> read(llvm::StringRef path);
+};
+
+#endif // __SHARD_INDEX_H__
@@ -0,0 +1,103 @@
+#include <llvm/ADT/Twine.h>
+
+#include "shard_writer.h"
+
+ShardStream::ShardStream(std::string prefix)
+    : raw_ostream(/*unbuffered=*/true), prefix(std::move(prefix)) {
+  open();
+}
+
+ShardStream::~ShardStream() { close(); }
+
+std::string ShardStream::path(llvm::StringRef prefix, std::uint32_t shard) {
+  return (prefix + "." + llvm::Twine(shard) + ".ndjson").str();
+}
+
+void ShardStream::open() {
+  std::error_code error;
+  file = MappedFileStream::create(path(prefix, shards), error);
+  if (error && !ec)
+    ec = error;
+  ++shards;
+}
+
+void ShardStream::next() {
+  close();
+  open();
+}
+
+std::error_code ShardStream::close() {
+  if (file) {
+    auto error = file->close();
+    if (error && !ec)
+      ec = error;
+    file.reset();
+  }
+  return ec;
+}
+
+// Writes to a shard that could not be opened are dropped, the error being
+// reported by close
+void ShardStream::write_impl(const char *ptr, std::size_t size) {
+  if (file)
+    file->write(ptr, size);
+  written += size;
+}
+
+void ShardWriter::nextShard() {
+  out.flush();
+  stream.next();
+  ++shard;
+  shardStart = out.bytesWritten();
+  shardNodes = 0;
+}
+
+void ShardWriter::beginUnit(std::string_view name) {
+  if (shardSize == 0 && shardNodes > 0)
+    nextShard();
+  auto &unit = shardIndex.units.emplace_back();
+  unit.nameOffset = shardIndex.names.size();
+  unit.nameSize = name.size();
+  unit.firstNode = dumped;
+  unit.shard = shard;
+  unit.offset = offset();
+  shardIndex.names.append(name);
+  inUnit = true;
+}
+
+void ShardWriter::endUnit() {
+  inUnit = false;
+  auto &unit = shardIndex.units.back();
+  unit.nodeCount = dumped - unit.firstNode;
+  unit.endShard = shard;
+  unit.endOffset = offset();
+}
+
+void ShardWriter::beginNode(const void *address, std::string_view name) {
+  if (shardSize > 0 && shardNodes > 0 && offset() >= shardSize)
+    nextShard();
+  // A unit starts where its first node does, which may be in a new shard
+  if (inUnit && shardIndex.units.back().firstNode == dumped) {
+    shardIndex.units.back().shard = shard;
+    shardIndex.units.back().offset = offset();
+  }
+  node = ids.get(address, name);
+  if (node >= shardIndex.nodes.size())
+    shardIndex.nodes.resize(node + 1, {0, NodeLocation::none, 0});
+  shardIndex.nodes[node] = {offset(), shard, 0};
+  ++shardNodes;
+  ++dumped;
+  out.beginNode(address, name);
+}
+
+void ShardWriter::endNode() {
+  out.endNode();
+  auto &location = shardIndex.nodes[node];
+  location.size = offset() - location.offset;
+}
+
+void ShardWriter::endDocument() {
+  out.endDocument();
+  shardIndex.nodes.resize(ids.size(), {0, NodeLocation::none, 0});
+  shardIndex.shardCount = stream.count();
+}
@@ -0,0 +1,129 @@
+#ifndef __SHARD_WRITER_H__
+#define __SHARD_WRITER_H__
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "json_writer.h"
+#include "mapped_file_stream.h"
+#include "node_ids.h"
+#include "shard_index.h"
+
+// === ShardStream class ===
+//
+// Writes to the shards "<prefix>.<n>.ndjson", a MappedFileStream each, moving
+// to the next one on request. Unbuffered, like MappedFileStream.
+
+class ShardStream final : public llvm::raw_ostream {
+public:
+  // Opens the first shard
+  explicit ShardStream(std::string prefix);
+  ~ShardStream() override;
+
+  // Closes the current shard and opens the next one
+  void next();
+
+  std::uint32_t count() const { return shards; }
+
+  // Closes the current shard. Returns the first error met while opening,
+  // writing or closing the shards.
+  std::error_code close();
+
+  static std::string path(llvm::StringRef prefix, std::uint32_t shard);
+
+private:
+  void open();
+  void write_impl(const char *ptr, std::size_t size) override;
+  std::uint64_t current_pos() const override { return written; }
+
+  std::string prefix;
+  std::unique_ptr<MappedFileStream> file;
+  std::uint32_t shards = 0;
+  std::uint64_t written = 0;
+  std::error_code ec;
+};
+
+// === ShardWriter class ===
+//
+// Forwards the dump to a JsonWriter with compact ids and the NDJSON layout,
+// which writes to a ShardStream, and builds the ShardIndex of the dump: the
+// line of each node and the nodes of each program unit. Shards are cut before
+// a program unit if `shardSize` is 0, and otherwise before the first node
+// once a shard holds `shardSize` bytes.
+//
+// Not split into fragments.
+
+class ShardWriter final : public NodeWriter {
+public:
+  ShardWriter(JsonWriter &out, ShardStream &stream, std::uint64_t shardSize)
+      : out(out), stream(stream), shardSize(shardSize) {}
+
+  // Valid once the document ends
+  const ShardIndex &index() const { return shardIndex; }
+
+  // The nodes dumped in between are those of a program unit
+  void beginUnit(std::string_view name);
+  void endUnit();
+
+  void beginDocument(const Document &document) override {
+    out.beginDocument(document);
+  }
+  void endDocument() override;
+
+  void beginNode(const void *address, std::string_view name) override;
+  void endNode() override;
+
+  void key(std::string_view name) override { out.key(name); }
+  void key(std::string_view name, std::string_view argument) override {
+    out.key(name, argument);
+  }
+
+  using NodeWriter::value;
+  void value(std::string_view v) override { out.value(v); }
+  void value(std::uint64_t v) override { out.value(v); }
+  void value(int v) override { out.value(v); }
+  void value(bool v) override { out.value(v); }
+
+  void source(std::string_view text) override { out.source(text); }
+  void position(const SourceRange &range) override { out.position(range); }
+
+  void id(const void *address, std::string_view name) override {
+    ids.get(address, name);
+    out.id(address, name);
+  }
+  void nullId() override { out.nullId(); }
+
+  void beginArray() override { out.beginArray(); }
+  void element() override { out.element(); }
+  void endArray() override { out.endArray(); }
+
+  void extents(llvm::ArrayRef<NodeExtent> extents) override {
+    out.extents(extents);
+  }
+
+  std::uint64_t bytesWritten() const override { return out.bytesWritten(); }
+
+private:
+  void nextShard();
+  std::uint64_t offset() const { return out.bytesWritten() - shardStart; }
+
+  JsonWriter &out;
+  ShardStream &stream;
+  std::uint64_t shardSize;
+  NodeIds ids; // The same as those of `out`
+  ShardIndex shardIndex;
+  std::uint32_t shard = 0;
+  std::uint64_t shardStart = 0; // Bytes written before the shard
+  std::uint32_t shardNodes = 0; // Nodes in the shard
+  std::uint32_t dumped = 0;     // Nodes in the dump
+  std::uint32_t node = 0;       // Compact id of the node being written
+  bool inUnit = false;
+};
+
+#endif // __SHARD_WRITER_H__
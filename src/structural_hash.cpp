@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Support/xxhash.h>
+
+#include "binary_format.h"
+#include "binary_reader.h"
+#include "null_writer.h"
+#include "structural_hash.h"
+
+namespace {
+
+constexpr char indexMagic[8] = {'F', 'D', 'A', 'S', 'T', 'H', 'I', 'X'};
+constexpr std::uint32_t indexVersion = 2;
+
+struct IndexHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t idCount;
+  std::uint64_t count;
+  std::uint32_t ids; // IdMode
+  std::uint32_t reserved;
+};
+
+llvm::Error invalidIndex(llvm::StringRef path, const llvm::Twine &message) {
+  return llvm::createStringError(llvm::inconvertibleErrorCode(),
+                                 path + ": " + message);
+}
+
+std::uint64_t hash(std::string_view bytes) {
+  return llvm::xxh3_64bits(llvm::arrayRefFromStringRef(
+      llvm::StringRef{bytes.data(), bytes.size()}));
+}
+
+} // namespace
+
+llvm::Error HashIndex::write(llvm::StringRef path) const {
+  std::error_code ec;
+  llvm::raw_fd_ostream os(path, ec);
+  if (ec)
+    return llvm::createStringError(ec, "cannot open " + path + ": " +
+                                           ec.message());
+
+  IndexHeader header;
+  std::memcpy(header.magic, indexMagic, sizeof(indexMagic));
+  header.version = indexVersion;
+  header.idCount = idCount;
+  header.count = entries.size();
+  header.ids = static_cast<std::uint32_t>(ids);
+  header.reserved = 0;
+  os.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  os.write(reinterpret_cast<const char *>(entries.data()),
+           entries.size() * sizeof(HashEntry));
+  os.close();
+  if (os.has_error()) {
+    ec = os.error();
+    os.clear_error();
+    return llvm::createStringError(ec, "cannot write " + path + ": " +
+                                           ec.message());
+  }
+  return llvm::Error::success();
+}
+
+llvm::Expected<HashIndex> HashIndex::read(llvm::StringRef path) {
+  auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/false,
+                                            /*RequiresNullTerminator=*/false);
+  if (!buffer)
+    return llvm::createStringError(buffer.getError(),
+                                   "cannot open " + path + ": " +
+                                       buffer.getError().message());
+  llvm::StringRef data = (*buffer)->getBuffer();
+
+  // A binary dump is hashed the way it was dumped
+  if (data.starts_with(
+          llvm::StringRef{ast_binary::magic, sizeof(ast_binary::magic)})) {
+    auto ast = BinaryAst::fromBuffer(std::move(*buffer));
+    if (!ast)
+      return ast.takeError();
+    if (ast->extents().empty() && !ast->order().empty())
+      return invalidIndex(path, "the dump has no extents");
+    if (ast->hasSourcePositions())
+      return invalidIndex(path, "the dump has source positions instead of "
+                                "the source text");
+
+    NullWriter null;
+    StructuralHasher hasher(null, false);
+    replay(*ast, hasher);
+    return hasher.index();
+  }
+
+  IndexHeader header;
+  if (data.size() < sizeof(header))
+    return invalidIndex(path, "not a hash index or a binary dump");
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (std::memcmp(header.magic, indexMagic, sizeof(indexMagic)) != 0)
+    return invalidIndex(path, "not a hash index or a binary dump");
+  if (header.version != indexVersion)
+    return invalidIndex(path, "unsupported hash index version " +
+                                  llvm::Twine(header.version));
+  if (header.count > (data.size() - sizeof(header)) / sizeof(HashEntry))
+    return invalidIndex(path, "truncated hash index");
+  if (header.ids != static_cast<std::uint32_t>(IdMode::Address) &&
+      header.ids != static_cast<std::uint32_t>(IdMode::Compact))
+    return invalidIndex(path, "bad id mode");
+
+  HashIndex index;
+  index.idCount = header.idCount;
+  index.ids = static_cast<IdMode>(header.ids);
+  index.entries.resize(header.count);
+  std::memcpy(index.entries.data(), data.data() + sizeof(header),
+              header.count * sizeof(HashEntry));
+  for (std::size_t i = 0; i < index.entries.size(); ++i) {
+    const auto &entry = index.entries[i];
+    if ((entry.parent != NodeExtent::noParent && entry.parent >= i) ||
+        entry.size == 0 || entry.size > index.entries.size() - i)
+      return invalidIndex(path, "bad hash index entry");
+  }
+  return index;
+}
+
+void StructuralHasher::hashValue(std::string_view v) {
+  bytes += 'S';
+  bytes += v;
+  bytes += '\0';
+}
+
+void StructuralHasher::beginNode(const void *address, std::string_view name) {
+  nodeIds.push_back(ids.get(address, name));
+  types.push_back(static_cast<std::uint32_t>(hash(name)));
+  bytes.assign(name);
+  bytes += '\0';
+  out.beginNode(address, name);
+}
+
+void StructuralHasher::endNode() {
+  locals.push_back(hash(bytes));
+  out.endNode();
+}
+
+void StructuralHasher::key(std::string_view name) {
+  bytes += 'K';
+  bytes += name;
+  bytes += '\0';
+  out.key(name);
+}
+
+// Hashed as the binary format stores it, so that replayed dumps hash the same
+void StructuralHasher::key(std::string_view name, std::string_view argument) {
+  bytes += 'K';
+  bytes += name;
+  bytes += '<';
+  bytes += argument;
+  bytes += '>';
+  bytes += '\0';
+  out.key(name, argument);
+}
+
+void StructuralHasher::value(std::string_view v) {
+  hashValue(v);
+  out.value(v);
+}
+
+void StructuralHasher::value(std::uint64_t v) {
+  hashValue(std::to_string(v));
+  out.value(v);
+}
+
+void StructuralHasher::value(int v) {
+  hashValue(std::to_string(v));
+  out.value(v);
+}
+
+void StructuralHasher::value(bool v) {
+  hashValue(v ? "1" : "0");
+  out.value(v);
+}
+
+void StructuralHasher::source(std::string_view text) {
+  hashValue(text);
+  out.source(text);
+}
+
+// Positions change whenever lines are added above, so they are not hashed
+void StructuralHasher::position(const SourceRange &range) {
+  bytes += 'P';
+  out.position(range);
+}
+
+// Children are hashed through the extents, and other references would tie
+// the hash to the numbering of the dump
+void StructuralHasher::id(const void *address, std::string_view name) {
+  ids.get(address, name);
+  bytes += 'I';
+  out.id(address, name);
+}
+
+void StructuralHasher::nullId() {
+  bytes += 'N';
+  out.nullId();
+}
+
+void StructuralHasher::beginArray() {
+  bytes += '[';
+  out.beginArray();
+}
+
+void StructuralHasher::endArray() {
+  bytes += ']';
+  out.endArray();
+}
+
+void StructuralHasher::extents(llvm::ArrayRef<NodeExtent> extents) {
+  nodeExtents = extents;
+  if (forwardExtents)
+    out.extents(extents);
+}
+
+void StructuralHasher::endDocument() {
+  // Nodes dumped after the parse tree, such as symbols, have no extent
+  std::size_t count = std::min(nodeExtents.size(), locals.size());
+  auto &entries = hashes.entries;
+  entries.resize(count);
+  std::vector<std::vector<std::uint32_t>> children(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    const auto &extent = nodeExtents[i];
+    entries[i] = {0, locals[i], nodeIds[i], extent.parent, extent.size,
+                  types[i]};
+    if (extent.parent != NodeExtent::noParent)
+      children[extent.parent].push_back(i);
+  }
+
+  // Children follow their parent, so they are hashed first going backwards
+  std::string combined;
+  for (std::size_t i = count; i-- > 0;) {
+    combined.assign(reinterpret_cast<const char *>(&entries[i].local),
+                    sizeof(std::uint64_t));
+    for (auto child : children[i])
+      combined.append(reinterpret_cast<const char *>(&entries[child].subtree),
+                      sizeof(std::uint64_t));
+    entries[i].subtree = hash(combined);
+  }
+  hashes.idCount = ids.size();
+
+  out.endDocument();
+}
@@ -0,0 +1,119 @@
+#ifndef __STRUCTURAL_HASH_H__
+#define __STRUCTURAL_HASH_H__
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/Error.h>
+
+#include "node_ids.h"
+#include "node_writer.h"
+#include "options.h"
+
+// Structural hashes of a node, at the index of the node in the order of the
+// dump, see NodeExtent
+struct HashEntry {
+  std::uint64_t subtree; // Of the node and its subtree
+  std::uint64_t local;   // Of the node alone: its type and properties
+  std::uint32_t id;      // Compact id of the node in its dump
+  std::uint32_t parent;  // As in NodeExtent
+  std::uint32_t size;    // As in NodeExtent
+  std::uint32_t type;    // Hash of the node name
+};
+
+// === HashIndex class ===
+//
+// Structural hashes of every node of a dump, written next to it with
+// -dump-ast-hash-index, so that a later dump of the same file can be diffed
+// against it without the dump itself. Files start with the magic
+// "FDASTHIX", a version, the number of compact ids, the number of entries and
+// the id mode of the dump, followed by the entries.
+
+struct HashIndex {
+  std::vector<HashEntry> entries;
+  std::uint32_t idCount = 0; // Compact ids of the dump, dumped or referenced
+  // Id mode of the dump. The ids of the entries are only those of the dump
+  // if it is compact.
+  IdMode ids = IdMode::Compact;
+
+  llvm::Error write(llvm::StringRef path) const;
+
+  // Reads an index, or builds it from a binary dump made with extents and
+  // without source positions
+  static llvm::Expected<HashIndex> read(llvm::StringRef path);
+};
+
+// === StructuralHasher class ===
+//
+// Forwards the dump to another writer and hashes each node on the way: its
+// name, keys and values, including its source text but neither its source
+// position nor the ids it refers to. The extents then give the children of
+// each node, whose subtree hashes are combined with its own in endDocument.
+// Two subtrees have the same hash when they have the same shape and content,
+// wherever they are in the file.
+//
+// Needs the extents, and is not split into fragments.
+
+class StructuralHasher final : public NodeWriter {
+public:
+  // Extents are only passed on to `out` if `forwardExtents` is set. `ids` is
+  // the id mode of `out`, recorded in the index.
+  StructuralHasher(NodeWriter &out, bool forwardExtents,
+                   IdMode ids = IdMode::Compact)
+      : out(out), forwardExtents(forwardExtents) {
+    hashes.ids = ids;
+  }
+
+  // Valid once the document ends
+  const HashIndex &index() const { return hashes; }
+
+  void beginDocument(const Document &document) override {
+    out.beginDocument(document);
+  }
+  void endDocument() override;
+
+  void beginNode(const void *address, std::string_view name) override;
+  void endNode() override;
+
+  void key(std::string_view name) override;
+  void key(std::string_view name, std::string_view argument) override;
+
+  using NodeWriter::value;
+  void value(std::string_view v) override;
+  void value(std::uint64_t v) override;
+  void value(int v) override;
+  void value(bool v) override;
+
+  void source(std::string_view text) override;
+  void position(const SourceRange &range) override;
+
+  void id(const void *address, std::string_view name) override;
+  void nullId() override;
+
+  void beginArray() override;
+  void element() override { out.element(); }
+  void endArray() override;
+
+  void extents(llvm::ArrayRef<NodeExtent> extents) override;
+
+  std::uint64_t bytesWritten() const override { return out.bytesWritten(); }
+
+private:
+  void hashValue(std::string_view v);
+
+  NodeWriter &out;
+  bool forwardExtents;
+  NodeIds ids;
+  std::string bytes; // Hashed content of the current node
+  std::vector<std::uint64_t> locals;
+  std::vector<std::uint32_t> nodeIds;
+  std::vector<std::uint32_t> types;
+  llvm::ArrayRef<NodeExtent> nodeExtents;
+  HashIndex hashes;
+};
+
+#endif // __STRUCTURAL_HASH_H__
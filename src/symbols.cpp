@@ -0,0 +1,117 @@
+#include <string>
+
+#include "flang/Evaluate/expression.h"
+#include "flang/Semantics/attr.h"
+#include "flang/Semantics/type.h"
+
+#include "symbols.h"
+
+using Fortran::semantics::Scope;
+using Fortran::semantics::Symbol;
+
+void dumpSymbol(NodeWriter &out, const Symbol *symbol) {
+  if (!symbol)
+    return;
+  out.key("symbol");
+  out.id(symbol, "Symbol");
+}
+
+void dumpType(NodeWriter &out, const Fortran::parser::TypedExpr &typedExpr) {
+  if (!typedExpr || !typedExpr->v)
+    return;
+  if (auto type = typedExpr->v->GetType()) {
+    out.key("type");
+    out.value(type->AsFortran());
+  }
+}
+
+static void dumpSymbolNode(NodeWriter &out, const Symbol &symbol) {
+  out.beginNode(&symbol, "Symbol");
+
+  out.key("name");
+  out.value(symbol.name().ToString());
+  out.key("details");
+  out.value(Fortran::semantics::DetailsToString(symbol.details()));
+  out.key("owner");
+  out.id(&symbol.owner(), "Scope");
+
+  if (const auto *type = symbol.GetType()) {
+    out.key("type");
+    out.value(type->AsFortran());
+  }
+
+  std::string attributes;
+  symbol.attrs().IterateOverMembers([&](Fortran::semantics::Attr attr) {
+    if (!attributes.empty())
+      attributes += ", ";
+    attributes += Fortran::semantics::AttrToString(attr);
+  });
+  if (!attributes.empty()) {
+    out.key("attributes");
+    out.value(attributes);
+  }
+
+  // Scope defined by the symbol, e.g. of a subprogram or a derived type
+  if (const auto *scope = symbol.scope()) {
+    out.key("scope");
+    out.id(scope, "Scope");
+  }
+
+  // Symbol a use or host association refers to
+  const Symbol &ultimate = symbol.GetUltimate();
+  if (&ultimate != &symbol) {
+    out.key("ultimate");
+    out.id(&ultimate, "Symbol");
+  }
+
+  out.endNode();
+}
+
+void dumpSymbolTable(NodeWriter &out, const Scope &scope) {
+  out.beginNode(&scope, "Scope");
+
+  out.key("kind");
+  out.value(Scope::EnumToString(scope.kind()));
+  if (const auto *symbol = scope.symbol()) {
+    out.key("symbol");
+    out.id(symbol, "Symbol");
+  }
+  if (!scope.IsGlobal()) {
+    out.key("parent");
+    out.id(&scope.parent(), "Scope");
+  }
+
+  out.key("symbols");
+  out.beginArray();
+  for (const auto &[name, symbol] : scope) {
+    out.element();
+    out.id(&*symbol, "Symbol");
+  }
+  out.endArray();
+
+  // Common blocks are not in the symbols of the scope
+  out.key("commonBlocks");
+  out.beginArray();
+  for (const auto &[name, symbol] : scope.commonBlocks()) {
+    out.element();
+    out.id(&*symbol, "Symbol");
+  }
+  out.endArray();
+
+  out.key("children");
+  out.beginArray();
+  for (const auto &child : scope.children()) {
+    out.element();
+    out.id(&child, "Scope");
+  }
+  out.endArray();
+
+  out.endNode();
+
+  for (const auto &[name, symbol] : scope)
+    dumpSymbolNode(out, *symbol);
+  for (const auto &[name, symbol] : scope.commonBlocks())
+    dumpSymbolNode(out, *symbol);
+  for (const auto &child : scope.children())
+    dumpSymbolTable(out, child);
+}
@@ -0,0 +1,25 @@
+#ifndef __SYMBOLS_H__
+#define __SYMBOLS_H__
+
+#include "flang/Parser/parse-tree.h"
+#include "flang/Semantics/scope.h"
+#include "flang/Semantics/symbol.h"
+
+#include "node_writer.h"
+
+// === Semantic information ===
+//
+// Once semantics has run, names refer to their symbol and expressions carry
+// their type. Scopes and symbols are dumped as nodes of type "Scope" and
+// "Symbol", so a name refers to its symbol by id like any other node.
+
+// "symbol" property of a name, if it was resolved
+void dumpSymbol(NodeWriter &out, const Fortran::semantics::Symbol *symbol);
+
+// "type" property of an expression, if it was analyzed and has a type
+void dumpType(NodeWriter &out, const Fortran::parser::TypedExpr &typedExpr);
+
+// Dumps `scope`, its symbols and the scopes nested in it
+void dumpSymbolTable(NodeWriter &out, const Fortran::semantics::Scope &scope);
+
+#endif // __SYMBOLS_H__
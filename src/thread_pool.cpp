@@ -0,0 +1,104 @@
+#include "thread_pool.h"
+
+namespace {
+
+// Pool and worker index of the current thread, if it is a worker
+thread_local const ThreadPool *currentPool = nullptr;
+thread_local unsigned currentWorker = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(unsigned threads) {
+  if (threads == 0)
+    threads = 1;
+  for (unsigned i = 0; i < threads; ++i)
+    queues.push_back(std::make_unique<Queue>());
+  for (unsigned i = 0; i < threads; ++i)
+    workers.emplace_back([this, i] { work(i); });
+}
+
+ThreadPool::~ThreadPool() {
+  wait();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  workAvailable.notify_all();
+  for (auto &worker : workers)
+    worker.join();
+}
+
+void ThreadPool::async(Task task) {
+  {
+    // Counted first, so the task cannot finish before it is counted. A worker
+    // woken in between retries until the task is in a queue.
+    std::lock_guard<std::mutex> lock(mutex);
+    ++pending;
+    ++queued;
+  }
+  {
+    auto &queue = currentPool == this ? *queues[currentWorker] : shared;
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+  workAvailable.notify_one();
+}
+
+void ThreadPool::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  allDone.wait(lock, [this] { return pending == 0; });
+}
+
+bool ThreadPool::pop(unsigned index, Task &task) {
+  {
+    auto &own = *queues[index];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty()) {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      return true;
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(shared.mutex);
+    if (!shared.tasks.empty()) {
+      task = std::move(shared.tasks.front());
+      shared.tasks.pop_front();
+      return true;
+    }
+  }
+  for (std::size_t i = 1; i < queues.size(); ++i) {
+    auto &victim = *queues[(index + i) % queues.size()];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (!victim.tasks.empty()) {
+      task = std::move(victim.tasks.front());
+      victim.tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::work(unsigned index) {
+  currentPool = this;
+  currentWorker = index;
+
+  Task task;
+  while (true) {
+    if (pop(index, task)) {
+      --queued;
+      task();
+      task = nullptr;
+
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--pending == 0)
+        allDone.notify_all();
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    workAvailable.wait(lock, [this] { return stopping || queued > 0; });
+    if (stopping && queued == 0)
+      return;
+  }
+}
@@ -0,0 +1,61 @@
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// === ThreadPool class ===
+//
+// Work-stealing pool: each worker owns a deque of the tasks submitted by its
+// tasks, and takes the most recent one first. Tasks submitted from outside the
+// pool go to a shared queue and are taken oldest first, so they finish roughly
+// in the order they were submitted. A worker with no task of its own takes one
+// from the shared queue, and otherwise steals the oldest task of another
+// worker.
+
+class ThreadPool {
+public:
+  using Task = std::function<void()>;
+
+  explicit ThreadPool(unsigned threads = std::thread::hardware_concurrency());
+  ThreadPool(const ThreadPool &) = delete;
+  ThreadPool &operator=(const ThreadPool &) = delete;
+  ~ThreadPool();
+
+  void async(Task task);
+
+  // Waits until every submitted task, including the ones submitted by other
+  // tasks, has finished
+  void wait();
+
+  unsigned size() const { return workers.size(); }
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void work(unsigned index);
+  bool pop(unsigned index, Task &task);
+
+  Queue shared; // Tasks submitted from outside the pool
+  std::vector<std::unique_ptr<Queue>> queues;
+  std::vector<std::thread> workers;
+
+  std::mutex mutex;
+  std::condition_variable workAvailable;
+  std::condition_variable allDone;
+  std::atomic<std::size_t> queued{0};
+  std::size_t pending = 0; // Submitted but not finished, guarded by mutex
+  bool stopping = false;
+};
+
+#endif // __THREAD_POOL_H__
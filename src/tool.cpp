@@ -0,0 +1,500 @@
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include "compressed_stream.h"
+#include "corpus.h"
+#include "driver.h"
+#include "dump_cache.h"
+#include "dump_ast.h"
+#include "mapped_file_stream.h"
+#include "modules.h"
+#include "options.h"
+#include "thread_pool.h"
+
+// === dump-ast tool ===
+//
+// Dumps the parse tree of many files in a single process. Files are handed to
+// a pool of workers, each running its own compiler instance, so the cost of
+// starting flang and loading the plugin is paid once for the whole batch.
+//
+// Each output is written to a temporary file and renamed into place once the
+// file has been dumped, so a failed run never leaves a partial output behind.
+// The summary follows the format of stats.txt written by fujitsu.py.
+//
+// Dumps with semantics need the .mod files of the modules a file uses. Files
+// are then scanned for the modules they define and use first, and each file
+// is dumped once the files it depends on are, writing its .mod files into a
+// directory of its own that its dependents search.
+
+namespace cl = llvm::cl;
+
+static cl::OptionCategory toolCategory("dump-ast options");
+
+static cl::list<std::string> inputs(cl::Positional,
+                                    cl::desc("<file or directory>..."),
+                                    cl::cat(toolCategory));
+
+static cl::opt<std::string>
+    filesFrom("files-from", cl::desc("Read the input paths from a file"),
+              cl::value_desc("path"), cl::cat(toolCategory));
+
+static cl::opt<std::string> outputDir("o", cl::desc("Output directory"),
+                                      cl::value_desc("dir"), cl::init("."),
+                                      cl::cat(toolCategory));
+
+static cl::opt<unsigned> threads("j", cl::desc("Number of worker threads"),
+                              cl::init(0), cl::cat(toolCategory));
+
+static cl::opt<unsigned> timeout(
+    "timeout",
+    cl::desc("Seconds after which a file is counted as a timeout. A file "
+             "cannot be interrupted: it keeps running in the background and "
+             "its output is discarded."),
+    cl::init(5), cl::cat(toolCategory));
+
+static cl::opt<std::string> statsFile("stats-file",
+                                      cl::desc("Where to write the summary"),
+                                      cl::value_desc("path"),
+                                      cl::init("stats.txt"),
+                                      cl::cat(toolCategory));
+
+static cl::opt<std::string>
+    extension("ext", cl::desc("Extension of the files searched in directories"),
+              cl::init("f90"), cl::cat(toolCategory));
+
+enum class OutputFormat { Json, Binary, Semantics };
+
+static cl::opt<OutputFormat> outputFormat(
+    "output-format", cl::desc("Format of the dumps"),
+    cl::values(clEnumValN(OutputFormat::Json, "json", "JSON (default)"),
+               clEnumValN(OutputFormat::Binary, "binary",
+                          "Binary AST format"),
+               clEnumValN(OutputFormat::Semantics, "sema",
+                          "JSON with the symbol table, in the order of the "
+                          "module dependencies")),
+    cl::init(OutputFormat::Json), cl::cat(toolCategory));
+
+static cl::opt<std::string>
+    moduleDir("module-dir",
+              cl::desc("Where to write the .mod files of sema dumps "
+                       "(default: <output dir>/modules)"),
+              cl::value_desc("dir"), cl::cat(toolCategory));
+
+static cl::list<std::string>
+    flangArguments("Xflang", cl::desc("Pass an argument to flang -fc1"),
+                   cl::value_desc("arg"), cl::cat(toolCategory));
+
+namespace {
+
+struct Job {
+  std::string input;
+  std::string output;
+};
+
+enum class Outcome { Success, Error, Timeout };
+
+// Adds `path` to `jobs`, searching directories recursively. Outputs are
+// named after their input, with the extension replaced by `suffix`. Files
+// given on their own are written at the top of the output directory.
+void collect(llvm::StringRef path, llvm::StringRef suffix,
+             std::vector<Job> &jobs) {
+  bool directory = llvm::sys::fs::is_directory(path);
+
+  std::vector<std::string> files;
+  collectSources(path, extension, files);
+  for (auto &file : files) {
+    // Keep the layout of the input directory
+    llvm::SmallString<256> output(outputDir);
+    llvm::sys::path::append(output,
+                            directory ? llvm::StringRef(file).drop_front(
+                                            path.size())
+                                      : llvm::sys::path::filename(file));
+    llvm::sys::path::replace_extension(output, suffix);
+    jobs.push_back({std::move(file), output.str().str()});
+  }
+}
+
+// Dumps `job` into `temporary`, and returns whether it succeeded
+bool dumpTo(const std::string &temporary, const Job &job,
+            const DumpOptions &options,
+            const std::vector<std::string> &arguments) {
+  std::error_code ec;
+  auto os = MappedFileStream::create(temporary, ec);
+  if (!os) {
+    llvm::errs() << temporary << ": " << ec.message() << "\n";
+    return false;
+  }
+
+  std::unique_ptr<DumpAST> action;
+  if (outputFormat == OutputFormat::Binary)
+    action = std::make_unique<DumpASTBinary>(*os, options);
+  else if (outputFormat == OutputFormat::Semantics)
+    action = std::make_unique<DumpASTSemantics>(*os, options);
+  else
+    action = std::make_unique<DumpAST>(*os, options);
+  bool success = runFrontendAction(*action, job.input, arguments);
+
+  if ((ec = os->close())) {
+    llvm::errs() << temporary << ": " << ec.message() << "\n";
+    success = false;
+  }
+  return success;
+}
+
+// A dump running on its own thread, which the tool stops waiting for at the
+// deadline
+struct Attempt {
+  std::mutex mutex;
+  std::condition_variable finished;
+  bool done = false;      // Guarded by mutex
+  bool abandoned = false; // Guarded by mutex
+  bool success = false;   // Guarded by mutex
+};
+
+// Number of dumps still running after their deadline
+std::atomic<std::size_t> abandonedDumps{0};
+
+// Frontends running, those of abandoned dumps included, which are kept within
+// the number of workers
+std::mutex frontendMutex;
+std::condition_variable frontendReleased;
+std::size_t runningFrontends = 0; // Guarded by frontendMutex
+std::size_t frontendLimit = 1;
+bool frontendsStuck = false;      // Guarded by frontendMutex
+
+// Waits for a frontend to be free. Returns false if every frontend has been
+// held by an abandoned dump for a whole timeout.
+bool acquireFrontend() {
+  std::unique_lock<std::mutex> lock(frontendMutex);
+  auto available = [] { return runningFrontends < frontendLimit; };
+  while (!available()) {
+    if (frontendsStuck)
+      return false;
+    if (!frontendReleased.wait_for(lock, std::chrono::seconds(timeout),
+                                   available) &&
+        abandonedDumps >= frontendLimit)
+      frontendsStuck = true;
+  }
+  ++runningFrontends;
+  return true;
+}
+
+void releaseFrontend() {
+  {
+    std::lock_guard<std::mutex> lock(frontendMutex);
+    --runningFrontends;
+    frontendsStuck = false;
+  }
+  frontendReleased.notify_one();
+}
+
+Outcome run(const Job &job, const DumpOptions &options,
+            const std::vector<std::string> &arguments) {
+  llvm::SmallString<256> directory(job.output);
+  llvm::sys::path::remove_filename(directory);
+  llvm::sys::fs::create_directories(directory);
+
+  // Abandoned dumps keep their frontend until they finish, so the worker
+  // waits for one rather than running more frontends than workers
+  if (!acquireFrontend())
+    return Outcome::Timeout;
+
+  // Actions cannot be interrupted, so the dump runs on a thread of its own
+  // that is abandoned if it misses the deadline. It then removes its output
+  // whenever it finishes, and the tool exits without waiting for it.
+  std::string temporary = job.output + ".tmp";
+  auto attempt = std::make_shared<Attempt>();
+  std::thread([attempt, temporary, job, options, arguments] {
+    bool success = dumpTo(temporary, job, options, arguments);
+    {
+      std::lock_guard<std::mutex> lock(attempt->mutex);
+      attempt->done = true;
+      attempt->success = success;
+      if (attempt->abandoned) {
+        llvm::sys::fs::remove(temporary);
+        --abandonedDumps;
+      }
+      attempt->finished.notify_all();
+    }
+    releaseFrontend();
+  }).detach();
+
+  {
+    std::unique_lock<std::mutex> lock(attempt->mutex);
+    if (!attempt->finished.wait_for(lock, std::chrono::seconds(timeout),
+                                    [&] { return attempt->done; })) {
+      attempt->abandoned = true;
+      ++abandonedDumps;
+      return Outcome::Timeout;
+    }
+  }
+
+  if (!attempt->success || llvm::sys::fs::rename(temporary, job.output)) {
+    llvm::sys::fs::remove(temporary);
+    return Outcome::Error;
+  }
+  return Outcome::Success;
+}
+
+// Dumps a job with the given frontend arguments, and returns whether it
+// succeeded
+using DumpJob =
+    std::function<bool(std::size_t, const std::vector<std::string> &)>;
+
+// Runs `dump` on each job once the jobs it depends on through modules have
+// succeeded, adding the arguments to write and find .mod files. Returns the
+// jobs that were not run because a job they depend on failed or timed out.
+std::vector<std::size_t>
+runInModuleOrder(const std::vector<Job> &jobs,
+                 const std::vector<std::string> &arguments, ThreadPool &pool,
+                 const DumpJob &dump) {
+  std::vector<std::string> files;
+  for (const auto &job : jobs)
+    files.push_back(job.input);
+
+  std::vector<ModuleInfo> modules(jobs.size());
+  for (std::size_t i = 0; i < jobs.size(); ++i)
+    pool.async([&, i] {
+      ScanModules scan(modules[i]);
+      runFrontendAction(scan, files[i], arguments);
+    });
+  pool.wait();
+  ModuleGraph graph(files, modules);
+
+  llvm::SmallString<256> root(moduleDir);
+  if (root.empty()) {
+    root = outputDir;
+    llvm::sys::path::append(root, "modules");
+  }
+  // Files may define modules of the same name, so each one writes its .mod
+  // files into its own directory
+  auto directory = [&](std::size_t i) {
+    llvm::SmallString<256> path(root);
+    llvm::sys::path::append(path, std::to_string(i));
+    return path.str().str();
+  };
+
+  std::mutex mutex;
+  std::vector<std::size_t> remaining(jobs.size()); // Guarded by mutex
+  std::vector<std::size_t> failed;                 // Guarded by mutex
+  for (std::size_t i = 0; i < jobs.size(); ++i)
+    remaining[i] = graph.dependencies(i).size();
+
+  auto runJob = [&](std::size_t i) {
+    std::vector<std::string> jobArguments = arguments;
+    std::string output = directory(i);
+    llvm::sys::fs::create_directories(output);
+    jobArguments.push_back("-module-dir");
+    jobArguments.push_back(output);
+    for (auto dependency : graph.closure(i)) {
+      jobArguments.push_back("-I");
+      jobArguments.push_back(directory(dependency));
+    }
+    return dump(i, jobArguments);
+  };
+
+  std::function<void(std::size_t)> schedule = [&](std::size_t i) {
+    pool.async([&, i] {
+      // A timed-out dump may still be writing its .mod files, and a failed
+      // one may have written only some, so its dependents are not released
+      if (!runJob(i)) {
+        std::lock_guard<std::mutex> lock(mutex);
+        failed.push_back(i);
+        return;
+      }
+
+      std::vector<std::size_t> ready;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto dependent : graph.dependents(i))
+          if (--remaining[dependent] == 0)
+            ready.push_back(dependent);
+      }
+      for (auto dependent : ready)
+        schedule(dependent);
+    });
+  };
+
+  for (std::size_t i = 0; i < jobs.size(); ++i)
+    if (remaining[i] == 0)
+      schedule(i);
+  pool.wait();
+
+  // The files depending on a failed file, directly or not, are not dumped
+  std::vector<bool> blocked(jobs.size(), false);
+  std::vector<std::size_t> skipped;
+  while (!failed.empty()) {
+    std::size_t i = failed.back();
+    failed.pop_back();
+    for (auto dependent : graph.dependents(i))
+      if (!blocked[dependent]) {
+        blocked[dependent] = true;
+        skipped.push_back(dependent);
+        failed.push_back(dependent);
+      }
+  }
+
+  // Files in a cycle, and the files depending on them, never become ready.
+  // They are dumped anyway, and fail if a module they need is missing.
+  for (std::size_t i = 0; i < jobs.size(); ++i)
+    if (remaining[i] != 0 && !blocked[i])
+      pool.async([&, i] { runJob(i); });
+  pool.wait();
+  return skipped;
+}
+
+} // namespace
+
+int main(int argc, const char **argv) {
+  cl::ParseCommandLineOptions(argc, argv,
+                              "Dumps the parse tree of Fortran files\n");
+
+  DumpOptions options = DumpOptions::fromCommandLine();
+  // Every job has its own output
+  options.output.clear();
+  options.shards.clear();
+  std::string suffix =
+      outputFormat == OutputFormat::Binary ? ".bin" : ".json";
+  suffix += CompressedStream::extension(
+      CompressedStream::available(options.compression));
+
+  std::vector<Job> jobs;
+  for (const auto &input : inputs)
+    collect(input, suffix, jobs);
+
+  if (!filesFrom.empty()) {
+    std::vector<std::string> paths;
+    if (!readPathList(filesFrom, paths))
+      return 1;
+    for (const auto &path : paths)
+      collect(path, suffix, jobs);
+  }
+
+  // Files of the same name from different directories would overwrite each
+  // other's output
+  llvm::StringMap<std::size_t> outputs;
+  for (std::size_t i = 0; i < jobs.size(); ++i) {
+    auto [it, inserted] = outputs.try_emplace(jobs[i].output, i);
+    if (!inserted) {
+      llvm::errs() << jobs[i].input << ": same output as "
+                   << jobs[it->second].input << ", " << jobs[i].output
+                   << "\n";
+      return 1;
+    }
+  }
+
+  llvm::outs() << "Found " << jobs.size() << " files\n";
+
+  initializeFrontend();
+
+  // Dumps that refer to the enum schema find it next to them, written once
+  // for the whole batch
+  if (options.enums == EnumMode::Reference &&
+      outputFormat != OutputFormat::Binary) {
+    std::string name = "schema-";
+    name += enumSchema().hash();
+    name += ".json";
+    llvm::SmallString<256> path(outputDir);
+    llvm::sys::path::append(path, name);
+    llvm::sys::fs::create_directories(outputDir);
+
+    std::error_code ec;
+    llvm::raw_fd_ostream schema(path, ec, llvm::sys::fs::OF_Text);
+    if (ec) {
+      llvm::errs() << path << ": " << ec.message() << "\n";
+      return 1;
+    }
+    dumpEnumSchema(schema);
+  }
+
+  std::vector<std::string> arguments(flangArguments.begin(),
+                                     flangArguments.end());
+
+  std::vector<Outcome> outcomes(jobs.size());
+  std::atomic<std::size_t> done{0};
+  std::mutex progressMutex;
+
+  auto dump = [&](std::size_t i, const std::vector<std::string> &jobArguments) {
+    outcomes[i] = run(jobs[i], options, jobArguments);
+
+    std::lock_guard<std::mutex> lock(progressMutex);
+    llvm::outs() << "(" << ++done << "/" << jobs.size() << ") "
+                 << jobs[i].input << "\n";
+    return outcomes[i] == Outcome::Success;
+  };
+
+  ThreadPool pool(threads ? threads : std::thread::hardware_concurrency());
+  frontendLimit = pool.size();
+  if (outputFormat == OutputFormat::Semantics) {
+    for (auto i : runInModuleOrder(jobs, arguments, pool, dump)) {
+      outcomes[i] = Outcome::Error;
+      llvm::errs() << jobs[i].input
+                   << ": not dumped, a file it depends on failed\n";
+    }
+  } else {
+    for (std::size_t i = 0; i < jobs.size(); ++i)
+      pool.async([&, i] { dump(i, arguments); });
+    pool.wait();
+  }
+
+  std::size_t errors = 0, timeouts = 0, successes = 0;
+  std::error_code ec;
+  llvm::raw_fd_ostream stats(statsFile, ec, llvm::sys::fs::OF_Text);
+  if (ec) {
+    llvm::errs() << statsFile << ": " << ec.message() << "\n";
+    return 1;
+  }
+
+  stats << "Errors:\n";
+  for (std::size_t i = 0; i < jobs.size(); ++i)
+    if (outcomes[i] == Outcome::Error) {
+      stats << jobs[i].input << "\n";
+      ++errors;
+    }
+
+  stats << "Timeouts:\n";
+  for (std::size_t i = 0; i < jobs.size(); ++i)
+    if (outcomes[i] == Outcome::Timeout) {
+      stats << jobs[i].input << "\n";
+      ++timeouts;
+    }
+
+  successes = jobs.size() - errors - timeouts;
+  stats << "\n#Errors: " << errors;
+  stats << "\n#Timeouts: " << timeouts;
+  stats << "\n#Successes: " << successes;
+  stats << "\nTotal: " << jobs.size();
+
+  if (auto *cache = DumpCache::get(options)) {
+    auto counters = cache->stats();
+    stats << "\n#Cache hits: " << counters.hits;
+    stats << "\n#Cache misses: " << counters.misses;
+    stats << "\n#Cache evictions: " << counters.evictions;
+  }
+
+  int status = errors || timeouts ? 1 : 0;
+  // Abandoned dumps may still be using the frontend, which exit would tear
+  // down under them
+  if (abandonedDumps > 0) {
+    stats.close();
+    llvm::outs().flush();
+    llvm::errs().flush();
+    std::_Exit(status);
+  }
+  return status;
+}
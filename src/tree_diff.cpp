@@ -0,0 +1,281 @@
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "json_writer.h"
+#include "tree_diff.h"
+
+using ast_binary::none;
+
+namespace {
+
+// Children of each entry, in order. The roots are the children of an extra
+// entry at the end.
+std::vector<std::vector<std::uint32_t>>
+childrenOf(const std::vector<HashEntry> &entries) {
+  std::vector<std::vector<std::uint32_t>> children(entries.size() + 1);
+  for (std::uint32_t i = 0; i < entries.size(); ++i) {
+    auto parent = entries[i].parent;
+    children[parent == none ? entries.size() : parent].push_back(i);
+  }
+  return children;
+}
+
+// Old subtrees with a given hash that are not matched yet
+struct Candidates {
+  std::vector<std::uint32_t> entries;
+  std::size_t first = 0; // Entries before it are matched
+};
+
+class TreeMatcher {
+public:
+  TreeMatcher(const HashIndex &current, const HashIndex &base)
+      : newNodes(current.entries), oldNodes(base.entries),
+        newChildren(childrenOf(newNodes)), oldChildren(childrenOf(oldNodes)),
+        match(newNodes.size(), none), paired(newNodes.size()),
+        used(oldNodes.size()) {
+    matchSubtrees();
+    pairNodes();
+  }
+
+  const std::vector<HashEntry> &newNodes;
+  const std::vector<HashEntry> &oldNodes;
+  std::vector<std::vector<std::uint32_t>> newChildren;
+  std::vector<std::vector<std::uint32_t>> oldChildren;
+  // Old entry of each new entry, or none
+  std::vector<std::uint32_t> match;
+  // Whether the match was made by pairNodes
+  std::vector<bool> paired;
+  // Whether each old entry is matched
+  std::vector<bool> used;
+
+  // Whether a paired node differs from its old node
+  bool changed(std::uint32_t i) const {
+    std::uint32_t old = match[i];
+    if (newNodes[i].local != oldNodes[old].local)
+      return true;
+    const auto &children = newChildren[i];
+    const auto &oldChildrenOf = oldChildren[old];
+    if (children.size() != oldChildrenOf.size())
+      return true;
+    for (std::size_t k = 0; k < children.size(); ++k)
+      if (match[children[k]] != oldChildrenOf[k])
+        return true;
+    return false;
+  }
+
+private:
+  // Whether no node of the old subtree is matched yet
+  bool available(std::uint32_t old) const {
+    for (std::uint32_t j = 0; j < oldNodes[old].size; ++j)
+      if (used[old + j])
+        return false;
+    return true;
+  }
+
+  // Subtrees with the same hash are only matched if their sizes and root
+  // types agree too, in case the hashes collide
+  bool fits(std::uint32_t old, std::uint32_t i) const {
+    return oldNodes[old].size == newNodes[i].size &&
+           oldNodes[old].type == newNodes[i].type;
+  }
+
+  void matchSubtrees() {
+    std::unordered_map<std::uint64_t, Candidates> bySubtree;
+    for (std::uint32_t i = 0; i < oldNodes.size(); ++i)
+      bySubtree[oldNodes[i].subtree].entries.push_back(i);
+
+    for (std::uint32_t i = 0; i < newNodes.size();) {
+      std::uint32_t size = newNodes[i].size;
+      auto it = bySubtree.find(newNodes[i].subtree);
+      if (it == bySubtree.end()) {
+        ++i;
+        continue;
+      }
+
+      // A subtree that overlaps a matched one never becomes available again,
+      // so the candidates before the first available one are dropped
+      auto &candidates = it->second;
+      std::uint32_t found = none;
+      for (std::size_t k = candidates.first; k < candidates.entries.size();
+           ++k) {
+        std::uint32_t old = candidates.entries[k];
+        bool free = available(old);
+        if (k == candidates.first && !free)
+          ++candidates.first;
+        if (free && fits(old, i)) {
+          found = old;
+          if (k == candidates.first)
+            ++candidates.first;
+          break;
+        }
+      }
+      if (found == none) {
+        ++i;
+        continue;
+      }
+
+      for (std::uint32_t j = 0; j < size; ++j) {
+        match[i + j] = found + j;
+        used[found + j] = true;
+      }
+      i += size;
+    }
+  }
+
+  void pairNodes() {
+    std::vector<std::uint32_t> ordinal(newNodes.size());
+    for (const auto &children : newChildren)
+      for (std::uint32_t k = 0; k < children.size(); ++k)
+        ordinal[children[k]] = k;
+
+    // Parents come first, so their pairs are known
+    for (std::uint32_t i = 0; i < newNodes.size(); ++i) {
+      if (match[i] != none)
+        continue;
+      std::uint32_t parent = newNodes[i].parent;
+      std::uint32_t oldParent;
+      if (parent == none)
+        oldParent = oldNodes.size();
+      else if ((oldParent = match[parent]) == none)
+        continue;
+
+      const auto &siblings = oldChildren[oldParent];
+      if (ordinal[i] >= siblings.size())
+        continue;
+      std::uint32_t old = siblings[ordinal[i]];
+      if (used[old] || oldNodes[old].type != newNodes[i].type)
+        continue;
+      match[i] = old;
+      paired[i] = true;
+      used[old] = true;
+    }
+  }
+};
+
+void writeIds(JsonWriter &out, const std::vector<std::uint32_t> &ids) {
+  out.write('[');
+  for (std::size_t i = 0; i < ids.size(); ++i) {
+    if (i > 0)
+      out.write(", ");
+    out.writeUInt(ids[i]);
+  }
+  out.write(']');
+}
+
+} // namespace
+
+void writeTreeDiff(llvm::raw_ostream &os, const BinaryAst &tree,
+                   const HashIndex &current, const HashIndex &base,
+                   const DumpOptions &options, std::string_view schemaHash) {
+  TreeMatcher matcher(current, base);
+  const auto &newNodes = current.entries;
+  const auto &oldNodes = base.entries;
+
+  // Ids of the new nodes, by their compact id in the new dump. Nodes that are
+  // only referenced get new ids when they are first written.
+  std::uint32_t next = base.idCount;
+  std::vector<std::uint32_t> ids(tree.nodes().size(), none);
+  for (std::uint32_t i = 0; i < newNodes.size(); ++i) {
+    auto old = matcher.match[i];
+    ids[tree.order()[i]] = old != none ? oldNodes[old].id : next++;
+  }
+  auto idOf = [&](std::uint32_t id) {
+    if (ids[id] == none)
+      ids[id] = next++;
+    return ids[id];
+  };
+
+  std::vector<std::uint32_t> deleted, modified, inserted, written;
+  for (std::uint32_t i = 0; i < oldNodes.size(); ++i) {
+    auto parent = oldNodes[i].parent;
+    if (!matcher.used[i] && (parent == none || matcher.used[parent]))
+      deleted.push_back(oldNodes[i].id);
+  }
+  for (std::uint32_t i = 0; i < newNodes.size(); ++i) {
+    auto parent = newNodes[i].parent;
+    if (matcher.match[i] == none) {
+      if (parent == none || matcher.match[parent] != none)
+        inserted.push_back(ids[tree.order()[i]]);
+      written.push_back(i);
+    } else if (matcher.paired[i] && matcher.changed(i)) {
+      modified.push_back(ids[tree.order()[i]]);
+      written.push_back(i);
+    }
+  }
+
+  DumpOptions diffOptions = options;
+  diffOptions.layout = JsonLayout::Document;
+  diffOptions.encoding = PropertyEncoding::Named;
+  JsonWriter out(os, diffOptions);
+  out.write("{\"deleted\": ");
+  writeIds(out, deleted);
+  out.write(",\n\"modified\": ");
+  writeIds(out, modified);
+  out.write(",\n\"inserted\": ");
+  writeIds(out, inserted);
+  if (tree.hasSourcePositions()) {
+    out.write(",\n\"files\": [");
+    for (std::size_t i = 0; i < tree.files().size(); ++i) {
+      if (i > 0)
+        out.write(", ");
+      out.value(std::string_view{tree.string(tree.files()[i])});
+    }
+    out.write(']');
+  }
+  out.write(",\n\"nodes\": [\n");
+
+  for (std::size_t n = 0; n < written.size(); ++n) {
+    std::uint32_t id = tree.order()[written[n]];
+    const auto &node = tree.node(id);
+    if (n > 0)
+      out.write(",\n");
+    out.write("{\n\"id\": ");
+    out.writeUInt(idOf(id));
+    out.key("type");
+    out.value(std::string_view{tree.typeName(node)});
+
+    for (const auto &property : tree.properties(node)) {
+      out.key(std::string_view{tree.string(property.key)});
+      switch (property.kind) {
+      case ast_binary::PropertyKind::String:
+        out.value(std::string_view{tree.string(property.value)});
+        break;
+      case ast_binary::PropertyKind::Range:
+        out.value(std::string_view{tree.source().data() + property.value,
+                                   property.count});
+        break;
+      case ast_binary::PropertyKind::Position: {
+        const auto &position = tree.position(property);
+        out.position({position.file, position.line, position.column,
+                      position.endLine, position.endColumn});
+        break;
+      }
+      case ast_binary::PropertyKind::Node:
+        out.writeUInt(idOf(property.value));
+        break;
+      case ast_binary::PropertyKind::Null:
+        out.write("null");
+        break;
+      case ast_binary::PropertyKind::Array:
+        out.beginArray();
+        for (auto element : tree.elements(property)) {
+          out.element();
+          if (element == none)
+            out.write("null");
+          else
+            out.writeUInt(idOf(element));
+        }
+        out.endArray();
+        break;
+      }
+    }
+    out.write("\n}");
+  }
+
+  out.write("],\n\"schema\": \"");
+  out.write(schemaHash);
+  out.write("\"\n}\n");
+  out.flush();
+}
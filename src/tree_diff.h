@@ -0,0 +1,37 @@
+#ifndef __TREE_DIFF_H__
+#define __TREE_DIFF_H__
+
+#include <string_view>
+
+#include <llvm/Support/raw_ostream.h>
+
+#include "binary_reader.h"
+#include "options.h"
+#include "structural_hash.h"
+
+// === Tree diff ===
+//
+// Difference between an old dump of a file, given by its HashIndex, and a new
+// dump of it in the binary format, with extents, whose HashIndex is
+// `current`. The old dump must have compact ids. Nodes of the new tree are
+// matched with old nodes in two passes: subtrees with the same structural
+// hash, size and root type are matched first, in the order of the new dump;
+// each remaining node is then paired with the old node of the same type at
+// the same place among the children of the node its parent is matched with.
+//
+// The diff is written as JSON and refers to matched nodes by their old compact
+// ids, new nodes getting ids after the old ones:
+//   "deleted"   old ids of the roots of the subtrees that were removed
+//   "modified"  old ids of the paired nodes whose properties or children
+//               changed
+//   "inserted"  ids of the roots of the new subtrees
+//   "nodes"     the modified and inserted nodes, as in a dump with compact
+//               ids
+// A subtree that moved is matched where it moved to, so only the nodes that
+// refer to it change.
+
+void writeTreeDiff(llvm::raw_ostream &os, const BinaryAst &tree,
+                   const HashIndex &current, const HashIndex &base,
+                   const DumpOptions &options, std::string_view schemaHash);
+
+#endif // __TREE_DIFF_H__